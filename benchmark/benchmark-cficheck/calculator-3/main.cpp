@@ -1,3 +1,4 @@
+#include "../../perf_counters.h"
 #include "Operation.h"
 #include <assert.h>
 #include <dlfcn.h>
@@ -102,7 +103,10 @@ int main(int argc, char *argv[])
     // Measure running time
     double res = 0;
     struct timeval start, end;
+    PerfCounters counters;
+    perf_counters_open(&counters);
     gettimeofday(&start, NULL);
+    perf_counters_start(&counters);
     for (int i = 0; i < nCycles; ++i)
     {
         auto add = operations[0];
@@ -111,11 +115,14 @@ int main(int argc, char *argv[])
         auto sub = operations[1];
         res += sub->execute(i, i + 1);
     }
+    perf_counters_stop(&counters);
     gettimeofday(&end, NULL);
     long seconds = end.tv_sec - start.tv_sec;
     long microseconds = end.tv_usec - start.tv_usec;
     long total_microseconds = seconds * 1000000 + microseconds;
     printf("Elapsed time: %ld microseconds\n", total_microseconds);
+    perf_counters_print(&counters);
+    perf_counters_close(&counters);
 
     printf("Final result: %f, EXE_Counter=%ld; DSO_Counter=%ld\n", res, EXE_Counter(), DSO_Counter());
 
@@ -5,6 +5,8 @@ CXXFLAGS 	?= -O2 -g
 
 # Target directories (in build order) 
 TARGET_DIRS := calculator-50 calculator-40 calculator-30 calculator-20 calculator-10 calculator-8 calculator-4 calculator-3 calculator-2 calculator-1
+# Projects emitted by generate_synthetic.py
+TARGET_DIRS += $(patsubst %/,%,$(sort $(wildcard synthetic-*/)))
 
 # Ensure variables are passed to sub-makes [cite: 3]
 .EXPORT_ALL_VARIABLES:
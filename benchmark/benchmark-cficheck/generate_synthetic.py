@@ -0,0 +1,398 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+Generates a synthetic cross-DSO CFI benchmark project.
+
+The calculator-N projects make a handful of virtual calls into one DSO; this
+generator emits projects at the sizes of real code bases, to probe how the
+verify cache and __cfi_check scale with the number of (type, vptr) pairs:
+
+  - --dsos plugins libOpn<d>.so, each with --classes concrete classes;
+  - the classes derive from --interfaces root classes Operation<k> through
+    chains of --depth levels, with virtual, non-virtual or mixed inheritance;
+  - main.cpp makes --call-sites distinct virtual call sites per cycle, each
+    seeing one receiver class (mono), POLY_DEGREE classes (poly) or every
+    class of its interface across all plugins (mega).
+
+The project lands in benchmark-cficheck/synthetic-<...>/ by default, with a
+Makefile in the shape of the calculator-N ones. common.mk and
+perfrun-cficheck.sh pick up every synthetic-* directory, so the
+build_llvm-*.sh scripts build it with each toolchain.
+
+Example:
+  python3 generate_synthetic.py --dsos 8 --classes 256 --depth 3 \\
+      --inheritance mixed --polymorphism mega
+  bash build_llvm-xdso-vcfi-opti.sh
+  cd synthetic-d8-c256-h3-mixed-mega && VCFI_MODE=XVCFI ./main 100000
+"""
+
+import argparse
+import os
+import random
+import sys
+
+POLY_DEGREE = 4  # Receiver classes per call site in poly mode
+PERF_COUNTERS_H = os.path.join(os.path.dirname(os.path.dirname(os.path.abspath(__file__))), "perf_counters.h")
+
+
+def class_name(k, i):
+    """Name of the i-th class of interface k within a plugin."""
+    return f"Op{k}_{i}"
+
+
+def generate_header(args):
+    """Operation.h: the root classes shared by main and all plugins."""
+    lines = [
+        "// Generated by generate_synthetic.py, do not edit.",
+        "#ifndef SYNTHETIC_OPERATION_H",
+        "#define SYNTHETIC_OPERATION_H",
+        "",
+    ]
+    for k in range(args.interfaces):
+        lines += [
+            f"class Operation{k}",
+            "{",
+            "public:",
+            f"    virtual ~Operation{k}() {{}}",
+            "    virtual double execute(double a, double b) = 0;",
+            "};",
+            "",
+        ]
+    lines += ["#endif", ""]
+    return "\n".join(lines)
+
+
+def plan_classes(args, rng):
+    """
+    Returns, per interface, the list of (parent, virtual) of the classes of one
+    plugin; parent is None for the classes deriving straight from the root.
+    Classes are dealt to the interfaces round-robin, and class i of an
+    interface sits at level i % depth of its chain.
+    """
+    plan = [[] for _ in range(args.interfaces)]
+    for c in range(args.classes):
+        k = c % args.interfaces
+        i = len(plan[k])
+        parent = None if i % args.depth == 0 else i - 1
+        if args.inheritance == "virtual":
+            virtual = True
+        elif args.inheritance == "nonvirtual":
+            virtual = False
+        else:
+            virtual = rng.random() < 0.5
+        plan[k].append((parent, virtual))
+    return plan
+
+
+def generate_plugin(args, d, plan):
+    """Operation<d>.cpp: the class hierarchies of plugin d and their creators."""
+    lines = [
+        "// Generated by generate_synthetic.py, do not edit.",
+        '#include "Operation.h"',
+        "",
+        "// Count execution times of all functions in this module",
+        "static long gCounter = 0;",
+        "",
+        f"namespace dso{d}",
+        "{",
+    ]
+    for k, classes in enumerate(plan):
+        for i, (parent, virtual) in enumerate(classes):
+            base = f"Operation{k}" if parent is None else class_name(k, parent)
+            lines += [
+                f"class {class_name(k, i)} : public {'virtual ' if virtual else ''}{base}",
+                "{",
+                "public:",
+                "    double execute(double a, double b) override",
+                "    {",
+                "        gCounter++;",
+                f"        return a * {(d * 7 + k * 3 + i) % 5 + 1} - b;",
+                "    }",
+                "};",
+                "",
+            ]
+    lines += [f"}} // namespace dso{d}", ""]
+
+    for k, classes in enumerate(plan):
+        lines += [
+            f'extern "C" int Count_Operation{k}()',
+            "{",
+            f"    return {len(classes)};",
+            "}",
+            "",
+            f'extern "C" Operation{k} *Create_Operation{k}(int index)',
+            "{",
+            "    switch (index)",
+            "    {",
+        ]
+        for i in range(len(classes)):
+            lines.append(f"    case {i}: return new dso{d}::{class_name(k, i)}();")
+        lines += [
+            "    default: return nullptr;",
+            "    }",
+            "}",
+            "",
+        ]
+    lines += [
+        'extern "C" long Return_Counter()',
+        "{",
+        "    return gCounter;",
+        "}",
+        "",
+    ]
+    return "\n".join(lines)
+
+
+def generate_main(args):
+    """main.cpp: loads the plugins, binds receivers to call sites and times the calls."""
+    k_of = [s % args.interfaces for s in range(args.call_sites)]
+    perf_counters = os.path.relpath(PERF_COUNTERS_H, os.path.abspath(args.output))
+    lines = [
+        "// Generated by generate_synthetic.py, do not edit.",
+        f"// {args.dsos} DSOs x {args.classes} classes, depth {args.depth}, "
+        f"{args.inheritance} inheritance, {args.call_sites} {args.polymorphism}morphic call sites",
+        f'#include "{perf_counters}"',
+        '#include "Operation.h"',
+        "#include <dlfcn.h>",
+        "#include <set>",
+        "#include <stdio.h>",
+        "#include <stdlib.h>",
+        "#include <string.h>",
+        "#include <sys/time.h>",
+        "#include <vector>",
+        "",
+        f"#define NDSOS {args.dsos}",
+        f"#define POLY_DEGREE {POLY_DEGREE}",
+        "",
+        "typedef int (*Count_fty)();",
+        "typedef long (*Counter_fty)();",
+        "",
+    ]
+    for k in range(args.interfaces):
+        lines += [
+            f"typedef Operation{k} *(*Creator{k}_fty)(int);",
+            f"static std::vector<Operation{k} *> gObjects{k};",
+        ]
+    lines += [
+        "",
+        "// Receivers of a call site, repeated up to a power of two so the loop",
+        "// picks one with a mask.",
+        "template <typename T>",
+        "static std::vector<T *> bind_site(const std::vector<T *> &objects, int site, std::set<T *> &used)",
+        "{",
+        "    std::vector<T *> receivers;",
+        "    size_t n = objects.size();",
+        "    size_t first = (size_t)site * 2654435761u % n;",
+        f"    size_t count = {dict(mono='1', poly='POLY_DEGREE < n ? POLY_DEGREE : n', mega='n')[args.polymorphism]};",
+        "    size_t size = 1;",
+        "    while (size < count)",
+        "        size *= 2;",
+        "    for (size_t i = 0; i < size; i++)",
+        "    {",
+        "        receivers.push_back(objects[(first + i % count) % n]);",
+        "        used.insert(receivers.back());",
+        "    }",
+        "    return receivers;",
+        "}",
+        "",
+        "int main(int argc, char *argv[])",
+        "{",
+        "    int nCycles = 0;",
+        "",
+        "    if (argc == 2)",
+        "        nCycles = atoi(argv[1]);",
+        "    else",
+        "        return -1;",
+        "",
+        "    const char *env = getenv(\"VCFI_MODE\");",
+        "    if (env != nullptr && strcmp(env, \"INTER\") == 0)",
+        "    {",
+        "        printf(\"Unexpected:Intra-module VCFI is enabled.\\n\");",
+        "        return -1;",
+        "    }",
+        "",
+        "    void *handles[NDSOS] = {nullptr};",
+        "    Counter_fty DSO_Counters[NDSOS] = {nullptr};",
+        "    for (int d = 0; d < NDSOS; d++)",
+        "    {",
+        "        char plugin[32];",
+        "        snprintf(plugin, sizeof(plugin), \"./libOpn%d.so\", d);",
+        "        void *handle = dlopen(plugin, RTLD_LAZY);",
+        "        if (!handle)",
+        "        {",
+        "            perror(\"Cannot open plugin\");",
+        "            return 1;",
+        "        }",
+        "        handles[d] = handle;",
+        "",
+        "        DSO_Counters[d] = (Counter_fty)dlsym(handle, \"Return_Counter\");",
+        "        if (!DSO_Counters[d])",
+        "        {",
+        "            perror(\"Cannot load symbol Return_Counter\");",
+        "            return 1;",
+        "        }",
+    ]
+    for k in range(args.interfaces):
+        lines += [
+            "",
+            f"        Count_fty count{k} = (Count_fty)dlsym(handle, \"Count_Operation{k}\");",
+            f"        Creator{k}_fty create{k} = (Creator{k}_fty)dlsym(handle, \"Create_Operation{k}\");",
+            f"        if (!count{k} || !create{k})",
+            "        {",
+            f"            perror(\"Cannot load symbols of Operation{k}\");",
+            "            return 1;",
+            "        }",
+            f"        for (int i = 0; i < count{k}(); i++)",
+            f"            gObjects{k}.push_back(create{k}(i));",
+        ]
+    lines += ["    }", ""]
+
+    # Every receiver of a call site is a distinct (type, vptr) signature.
+    for k in range(args.interfaces):
+        lines.append(f"    std::set<Operation{k} *> used{k};")
+    for s in range(args.call_sites):
+        k = k_of[s]
+        lines.append(f"    std::vector<Operation{k} *> site{s} = bind_site(gObjects{k}, {s}, used{k});")
+    lines.append(
+        "    size_t nSignatures = "
+        + " + ".join(f"used{k}.size()" for k in range(args.interfaces))
+        + ";"
+    )
+    lines += [
+        f"    printf(\"{args.dsos} DSOs, {args.classes} classes per DSO, {args.call_sites} call sites, %zu signatures\\n\", nSignatures);",
+        "",
+        "    // Measure running time",
+        "    double res = 0;",
+        "    struct timeval start, end;",
+        "    PerfCounters counters;",
+        "    perf_counters_open(&counters);",
+        "    gettimeofday(&start, NULL);",
+        "    perf_counters_start(&counters);",
+        "    for (int i = 0; i < nCycles; ++i)",
+        "    {",
+    ]
+    for s in range(args.call_sites):
+        lines.append(f"        res += site{s}[i & (site{s}.size() - 1)]->execute(i, i + 1);")
+    lines += [
+        "    }",
+        "    perf_counters_stop(&counters);",
+        "    gettimeofday(&end, NULL);",
+        "    long seconds = end.tv_sec - start.tv_sec;",
+        "    long microseconds = end.tv_usec - start.tv_usec;",
+        "    long total_microseconds = seconds * 1000000 + microseconds;",
+        "    printf(\"Elapsed time: %ld microseconds\\n\", total_microseconds);",
+        "    perf_counters_print(&counters);",
+        "    perf_counters_close(&counters);",
+        "",
+        "    long DSO_Counter = 0;",
+        "    for (auto counter : DSO_Counters)",
+        "        DSO_Counter += counter();",
+        "    printf(\"Final result: %f, DSO_Counter=%ld\\n\", res, DSO_Counter);",
+        "",
+    ]
+    for k in range(args.interfaces):
+        lines += [
+            f"    for (auto object : gObjects{k})",
+            "        delete object;",
+        ]
+    lines += [
+        "    for (auto handle : handles)",
+        "    {",
+        "        if (handle != nullptr)",
+        "            dlclose(handle);",
+        "    }",
+        "",
+        "    return 0;",
+        "}",
+        "",
+    ]
+    return "\n".join(lines)
+
+
+def generate_makefile(args):
+    """Makefile in the shape of the calculator-N ones."""
+    plugins = " ".join(f"libOpn{d}.so" for d in range(args.dsos))
+    return f"""\
+# Generated by generate_synthetic.py, do not edit.
+PROJECT_CXX	?= clang++
+CXXFLAGS 	?= -fuse-ld=lld -flto -fvisibility=default -fsanitize=cfi-vcall -fsanitize-cfi-cross-dso -O0 -g
+
+PLUGINS := {plugins}
+
+all: main $(PLUGINS)
+
+
+libOpn%.so: Operation%.cpp Operation.h
+	${{PROJECT_CXX}} ${{CXXFLAGS}} -fPIC -shared -o $@ $<
+
+
+main: main.cpp Operation.h
+	${{PROJECT_CXX}} ${{CXXFLAGS}} -no-pie -o $@ $< -ldl
+
+
+run: main $(PLUGINS)
+	./main 1000000
+
+
+clean:
+	rm -rf main $(PLUGINS)
+"""
+
+
+def main():
+    """Main function to parse arguments and write the project."""
+    parser = argparse.ArgumentParser(
+        description="Generates a synthetic many-DSO, many-class cross-DSO CFI benchmark project."
+    )
+    parser.add_argument("--dsos", type=int, default=8, help="Number of plugin DSOs (default: 8)")
+    parser.add_argument("--classes", type=int, default=64, help="Concrete classes per DSO (default: 64)")
+    parser.add_argument("--interfaces", type=int, default=4, help="Root classes the call sites go through (default: 4)")
+    parser.add_argument("--depth", type=int, default=1, help="Levels of the inheritance chains below a root (default: 1)")
+    parser.add_argument("--inheritance", choices=["virtual", "nonvirtual", "mixed"], default="nonvirtual",
+                        help="Inheritance between the levels of a chain (default: nonvirtual)")
+    parser.add_argument("--polymorphism", choices=["mono", "poly", "mega"], default="poly",
+                        help="Receiver classes per call site: one, %d, or all of its interface (default: poly)" % POLY_DEGREE)
+    parser.add_argument("--call-sites", type=int, default=None,
+                        help="Virtual call sites in the timed loop (default: one per interface)")
+    parser.add_argument("--seed", type=int, default=0, help="Seed of the mixed inheritance choices (default: 0)")
+    parser.add_argument("-o", "--output", default=None,
+                        help="Project directory (default: synthetic-d<dsos>-c<classes>-h<depth>-<inheritance>-<polymorphism>)")
+    args = parser.parse_args()
+
+    if args.call_sites is None:
+        args.call_sites = args.interfaces
+    for name in ("dsos", "classes", "interfaces", "depth", "call_sites"):
+        if getattr(args, name) <= 0:
+            parser.error(f"--{name.replace('_', '-')} must be positive")
+    if args.classes < args.interfaces:
+        parser.error("--classes must be at least --interfaces")
+
+    if args.output is None:
+        args.output = os.path.join(
+            os.path.dirname(os.path.abspath(__file__)),
+            f"synthetic-d{args.dsos}-c{args.classes}-h{args.depth}-{args.inheritance}-{args.polymorphism}",
+        )
+
+    # Same hierarchy shape in every plugin, distinct classes by namespace.
+    plan = plan_classes(args, random.Random(args.seed))
+
+    os.makedirs(args.output, exist_ok=True)
+    files = {
+        "Operation.h": generate_header(args),
+        "main.cpp": generate_main(args),
+        "Makefile": generate_makefile(args),
+    }
+    for d in range(args.dsos):
+        files[f"Operation{d}.cpp"] = generate_plugin(args, d, plan)
+    for name, content in files.items():
+        with open(os.path.join(args.output, name), "w") as f:
+            f.write(content)
+
+    print(f"Generated {args.output}: {args.dsos} DSOs x {args.classes} classes, "
+          f"{args.call_sites} {args.polymorphism}morphic call sites")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -1,5 +1,7 @@
 #!/bin/bash
 # This script runs a performance benchmark across multiple directories.
+# For builds under every toolchain, statistics and overhead reports, use
+# ../run_benchmarks.py instead.
 
 # --- USAGE ---
 # ./perfrun-cficheck.sh <base_cycles>
@@ -34,8 +36,9 @@ measure_time(){
 for run in {1..5}; do
     echo "=== Run $run ==="
     
-    # Loop through a predefined list of benchmark directories.
-    for dir in calculator-1 calculator-2 calculator-3 calculator-4 calculator-8 calculator-10 calculator-20 calculator-30 calculator-40 calculator-50; do
+    # Loop through a predefined list of benchmark directories, then the projects
+    # emitted by generate_synthetic.py.
+    for dir in calculator-1 calculator-2 calculator-3 calculator-4 calculator-8 calculator-10 calculator-20 calculator-30 calculator-40 calculator-50 $(cd $ROOT_DIR && ls -d synthetic-*/ 2>/dev/null); do
         # Change into the target subdirectory from the root directory.
         echo "cd $ROOT_DIR/$dir"
         cd $ROOT_DIR/$dir
@@ -1,3 +1,4 @@
+#include "../../perf_counters.h"
 #include "operation.cpp"
 #include "operation.h"
 #include <assert.h>
@@ -71,7 +72,10 @@ int main(int argc, char *argv[])
     // Measure running time
     long long res = 0;
     struct timeval start, end;
+    PerfCounters counters;
+    perf_counters_open(&counters);
     gettimeofday(&start, NULL);
+    perf_counters_start(&counters);
     for (int i = 0; i < nCycles; ++i)
     {
         for (int j = 0; j < nopor; j++)
@@ -80,11 +84,14 @@ int main(int argc, char *argv[])
             res += op->execute(u++, v++);
         }
     }
+    perf_counters_stop(&counters);
     gettimeofday(&end, NULL);
     long seconds = end.tv_sec - start.tv_sec;
     long microseconds = end.tv_usec - start.tv_usec;
     long total_microseconds = seconds * 1000000 + microseconds;
     printf("Elapsed time: %ld microseconds\n", total_microseconds);
+    perf_counters_print(&counters);
+    perf_counters_close(&counters);
 
     printf("Final result: %lld, EXE_Counter=%ld; DSO_ADD_Counter=%ld, DSO_SUB_Counter=%ld/2\n",
            res, EXE_Counter(), DSO_Counter[0](), DSO_Counter[1]());
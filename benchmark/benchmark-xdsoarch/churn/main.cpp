@@ -0,0 +1,282 @@
+#include "Task.h"
+#include <algorithm>
+#include <atomic>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// dlopen/dlclose churn benchmark, after services that hot-reload plugins.
+//
+// nThreads threads make cross-DSO virtual calls on the classes of the
+// libStable*.so plugins, which stay loaded; together they fit into the verify
+// cache, so it should hit all the time. Meanwhile the main thread reloads the
+// nChurn libChurn*.so plugins nReloads times: dlopen all of them, call every
+// class they define CHURN_CALLS times, often enough for xvcfiopt to migrate
+// it (leaving verify-cache entries that point into them), and dlclose them
+// again. Every dlopen and dlclose goes through the CFI runtime's
+// EnterLoader/ExitLoader and rebuilds the shadow.
+//
+// Reports:
+//  - dlopen and dlclose latency percentiles per plugin;
+//  - the call throughput of the threads during the reloads, against the
+//    throughput before them;
+//  - the migrations while the churn plugins were loaded, which shows that
+//    their classes did reach the verify cache, and the verify-cache hit rate
+//    over the HIT_WINDOW_US after each reload. Both need
+//    CFI_OPTIONS=xvcfi_print_stats=1 and read n/a without xvcfiopt.
+//
+// Usage: ./main <nReloads> [nThreads] [nChurn]
+//   nThreads defaults to the number of online CPUs minus one (at least one),
+//   nChurn to all churn plugins.
+
+#ifndef NSTABLE
+#define NSTABLE 4
+#endif
+#ifndef NCHURN
+#define NCHURN 8
+#endif
+#ifndef CHURN_CALLS
+#define CHURN_CALLS 32 // Calls per churn class and reload, past xvcfi_miss_threshold / 5 misses
+#endif
+#define BATCH_SIZE 64         // Calls between updates of a thread's call count
+#define BASELINE_MS 200       // Length of the throughput baseline
+#define HIT_WINDOW_US 2000    // Length of the hit-rate window after a reload
+
+// Layout of xvcfi_engine_stats_t in the xvcfiopt runtime
+struct XvcfiStats
+{
+    unsigned long long calls;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long bypasses;
+    unsigned long long migrations;
+};
+
+// Only provided by the xvcfiopt runtime.
+extern "C" void __xvcfiopt_get_stats(XvcfiStats *stats) __attribute__((weak));
+
+typedef Task *(*Creator_fty)(int);
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static XvcfiStats read_stats()
+{
+    XvcfiStats stats = {0, 0, 0, 0, 0};
+    if (__xvcfiopt_get_stats)
+        __xvcfiopt_get_stats(&stats);
+    return stats;
+}
+
+struct Caller
+{
+    std::thread thread;
+    std::atomic<long> calls{0};
+    long result = 0;
+};
+
+// Call random stable tasks until stop is set.
+static void run_caller(Caller *caller, Task **tasks, int nTasks, unsigned seed, std::atomic<bool> *stop)
+{
+    unsigned rng = seed * 2654435761u + 1;
+    long res = 0;
+    long calls = 0;
+
+    while (!stop->load(std::memory_order_relaxed))
+    {
+        for (int j = 0; j < BATCH_SIZE; j++)
+        {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            res += tasks[rng % nTasks]->run(res);
+        }
+        calls += BATCH_SIZE;
+        caller->calls.store(calls, std::memory_order_relaxed);
+    }
+    caller->result = res;
+}
+
+static long total_calls(std::vector<Caller> &callers)
+{
+    long sum = 0;
+    for (auto &caller : callers)
+        sum += caller.calls.load(std::memory_order_relaxed);
+    return sum;
+}
+
+static double percentile(const std::vector<double> &sorted, double pct)
+{
+    return sorted[(size_t)(pct / 100 * (sorted.size() - 1) + 0.5)];
+}
+
+static void print_latency(const char *name, std::vector<double> &latencies)
+{
+    std::sort(latencies.begin(), latencies.end());
+    printf("%-8s %10.1f %10.1f %10.1f %10.1f\n", name, percentile(latencies, 50), percentile(latencies, 90),
+           percentile(latencies, 99), latencies.back());
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 4)
+    {
+        fprintf(stderr, "Usage: %s <nReloads> [nThreads] [nChurn]\n", argv[0]);
+        return -1;
+    }
+    int nReloads = atoi(argv[1]);
+    int nThreads = argc > 2 ? atoi(argv[2]) : std::max((int)sysconf(_SC_NPROCESSORS_ONLN) - 1, 1);
+    int nChurn = argc > 3 ? atoi(argv[3]) : NCHURN;
+    if (nReloads <= 0 || nThreads <= 0 || nChurn <= 0 || nChurn > NCHURN)
+    {
+        fprintf(stderr, "nReloads and nThreads must be positive, nChurn in [1, %d]\n", NCHURN);
+        return -1;
+    }
+
+    void *stableHandles[NSTABLE] = {nullptr};
+    std::vector<Task *> tasks;
+
+    for (int p = 0; p < NSTABLE; p++)
+    {
+        char plugin[32];
+        snprintf(plugin, sizeof(plugin), "./libStable%d.so", p);
+        void *handle = dlopen(plugin, RTLD_LAZY);
+        if (!handle)
+        {
+            perror("Cannot open plugin");
+            return 1;
+        }
+        stableHandles[p] = handle;
+
+        Creator_fty create = (Creator_fty)dlsym(handle, "create");
+        if (!create)
+        {
+            perror("Cannot load symbol create");
+            return 1;
+        }
+        for (int i = 0; i < TASKS_PER_PLUGIN; i++)
+            tasks.push_back(create(i));
+    }
+
+    printf("%d reloads of %d plugins, %d calling threads on %d classes, xvcfiopt stats %s\n", nReloads, nChurn,
+           nThreads, (int)tasks.size(), __xvcfiopt_get_stats ? "available" : "n/a");
+
+    std::vector<Caller> callers(nThreads);
+    std::atomic<bool> stop(false);
+    for (int t = 0; t < nThreads; t++)
+        callers[t].thread = std::thread(run_caller, &callers[t], tasks.data(), (int)tasks.size(), (unsigned)t, &stop);
+
+    // Throughput without reloads
+    long baseCalls = total_calls(callers);
+    long long baseStart = now_ns();
+    usleep(BASELINE_MS * 1000);
+    double baseThroughput = (double)(total_calls(callers) - baseCalls) / (now_ns() - baseStart) * 1000; // Mcalls/s
+
+    std::vector<double> openLatencies, closeLatencies; // us per plugin
+    std::vector<double> hitRates;                      // % after every reload
+    unsigned long long churnMigrations = 0;            // While the churn plugins were loaded
+    long long reloadTime = 0;
+    long reloadCalls = 0;
+    long checksum = 0;
+
+    for (int r = 0; r < nReloads; r++)
+    {
+        void *handles[NCHURN] = {nullptr};
+        long calls = total_calls(callers);
+        long long start = now_ns();
+        XvcfiStats loaded = read_stats();
+
+        for (int p = 0; p < nChurn; p++)
+        {
+            char plugin[32];
+            snprintf(plugin, sizeof(plugin), "./libChurn%d.so", p);
+            long long t0 = now_ns();
+            handles[p] = dlopen(plugin, RTLD_NOW);
+            openLatencies.push_back((now_ns() - t0) / 1000.0);
+            if (!handles[p])
+            {
+                perror("Cannot open plugin");
+                return 1;
+            }
+
+            Creator_fty create = (Creator_fty)dlsym(handles[p], "create");
+            if (!create)
+            {
+                perror("Cannot load symbol create");
+                return 1;
+            }
+            for (int i = 0; i < TASKS_PER_PLUGIN; i++)
+            {
+                Task *task = create(i);
+                for (int c = 0; c < CHURN_CALLS; c++)
+                    checksum += task->run(i + c);
+                delete task;
+            }
+        }
+        churnMigrations += read_stats().migrations - loaded.migrations;
+
+        for (int p = 0; p < nChurn; p++)
+        {
+            long long t0 = now_ns();
+            dlclose(handles[p]);
+            closeLatencies.push_back((now_ns() - t0) / 1000.0);
+        }
+        reloadTime += now_ns() - start;
+        reloadCalls += total_calls(callers) - calls;
+
+        XvcfiStats before = read_stats();
+        usleep(HIT_WINDOW_US);
+        XvcfiStats after = read_stats();
+        if (after.calls > before.calls)
+            hitRates.push_back(100.0 * (after.hits - before.hits) / (after.calls - before.calls));
+    }
+
+    stop.store(true);
+    for (auto &caller : callers)
+    {
+        caller.thread.join();
+        checksum += caller.result;
+    }
+
+    printf("%-8s %10s %10s %10s %10s\n", "us", "p50", "p90", "p99", "max");
+    print_latency("dlopen", openLatencies);
+    print_latency("dlclose", closeLatencies);
+
+    double reloadThroughput = reloadTime ? (double)reloadCalls / reloadTime * 1000 : 0;
+    printf("Throughput: %.2f Mcalls/s before reloads, %.2f Mcalls/s during reloads (%.2f)\n", baseThroughput,
+           reloadThroughput, baseThroughput ? reloadThroughput / baseThroughput : 0);
+
+    if (!__xvcfiopt_get_stats || hitRates.empty())
+        printf("Migrations while loaded: n/a\n");
+    else
+        printf("Migrations while loaded: %.1f per reload\n", (double)churnMigrations / nReloads);
+    if (hitRates.empty())
+        printf("Hit rate after reload: n/a\n");
+    else
+    {
+        double sum = 0;
+        for (double rate : hitRates)
+            sum += rate;
+        printf("Hit rate after reload: first %.2f%%, mean %.2f%%, min %.2f%%\n", hitRates[0],
+               sum / hitRates.size(), *std::min_element(hitRates.begin(), hitRates.end()));
+    }
+    printf("Final result: %ld\n", checksum);
+
+    for (auto task : tasks)
+        delete task;
+    for (auto handle : stableHandles)
+    {
+        if (handle != nullptr)
+            dlclose(handle);
+    }
+
+    return 0;
+}
@@ -4,7 +4,7 @@ PROJECT_CXX	?= clang++
 CXXFLAGS 	?= -O2 -g
 
 # Target directories (in build order) 
-TARGET_DIRS := calculator logger imagefilter
+TARGET_DIRS := calculator logger imagefilter multithread thrash churn startup
 
 
 # Ensure variables are passed to sub-makes [cite: 3]
@@ -0,0 +1,20 @@
+
+#ifndef c9b11aa0_7a94_46c0_944e_53f6f1fc816b
+#define c9b11aa0_7a94_46c0_944e_53f6f1fc816b
+
+// Number of Task classes each plugin defines
+#ifndef TASKS_PER_PLUGIN
+#define TASKS_PER_PLUGIN 128
+#endif
+
+class Task
+{
+public:
+    virtual ~Task() {}
+    virtual long run(long x) = 0;
+};
+
+// Create an instance of the index-th Task class of a plugin
+extern "C" Task *create(int index);
+
+#endif // !c9b11aa0_7a94_46c0_944e_53f6f1fc816b
@@ -0,0 +1,52 @@
+#include "Task.h"
+
+// Built once per plugin with -DPLUGIN_ID=<n>. Every plugin defines
+// TASKS_PER_PLUGIN classes with their own vtables, so that the benchmark can
+// make as many distinct cross-DSO vcall signatures as it needs.
+#ifndef PLUGIN_ID
+#define PLUGIN_ID 0
+#endif
+
+#define PLUGIN_NS_(ID) plugin##ID
+#define PLUGIN_NS(ID) PLUGIN_NS_(ID)
+
+namespace PLUGIN_NS(PLUGIN_ID)
+{
+
+template <int N>
+class TaskImpl : public Task
+{
+public:
+    long run(long x) override
+    {
+        return x * (N + 1) + PLUGIN_ID;
+    }
+};
+
+// Instances of TaskImpl<0> ... TaskImpl<N>, indexed by their N
+template <int N>
+struct TaskFactory
+{
+    static Task *create(int index)
+    {
+        if (index == N)
+            return new TaskImpl<N>();
+        return TaskFactory<N - 1>::create(index);
+    }
+};
+
+template <>
+struct TaskFactory<-1>
+{
+    static Task *create(int index)
+    {
+        return nullptr;
+    }
+};
+
+} // namespace PLUGIN_NS(PLUGIN_ID)
+
+extern "C" Task *create(int index)
+{
+    return PLUGIN_NS(PLUGIN_ID)::TaskFactory<TASKS_PER_PLUGIN - 1>::create(index);
+}
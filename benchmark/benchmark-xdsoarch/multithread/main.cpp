@@ -0,0 +1,219 @@
+#include "../../perf_counters.h"
+#include "Task.h"
+#include <algorithm>
+#include <atomic>
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Multi-threaded cross-DSO vcall benchmark.
+//
+// Every thread makes nCycles virtual calls through Task*, on objects of the
+// classes of the libTasks*.so plugins picked at random from a working set of
+// nTasks classes. The benchmark runs for 1, 2, 4, ... threads up to
+// maxThreads and reports per thread count:
+//  - the throughput, and its scaling over one thread;
+//  - latency percentiles of the calls, timed in batches of BATCH_SIZE;
+//  - the slowpath fallbacks (calls that reached __cfi_check), cache bypasses
+//    and migrations of the xvcfiopt runtime. These need
+//    CFI_OPTIONS=xvcfi_print_stats=1, and read n/a without xvcfiopt;
+//  - the hardware counters of all threads over the timed calls, on a line of
+//    their own (see perf_counters.h).
+//
+// Usage: ./main <nCycles> [maxThreads] [nTasks]
+//   maxThreads defaults to the number of online CPUs, nTasks to all classes.
+
+#define BATCH_SIZE 64 // Calls timed together
+#define NPLUGINS 8
+
+// Layout of xvcfi_engine_stats_t in the xvcfiopt runtime
+struct XvcfiStats
+{
+    unsigned long long calls;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long bypasses;
+    unsigned long long migrations;
+};
+
+// Only provided by the xvcfiopt runtime.
+extern "C" void __xvcfiopt_get_stats(XvcfiStats *stats) __attribute__((weak));
+
+typedef Task *(*Creator_fty)(int);
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static XvcfiStats read_stats()
+{
+    XvcfiStats stats = {0, 0, 0, 0, 0};
+    if (__xvcfiopt_get_stats)
+        __xvcfiopt_get_stats(&stats);
+    return stats;
+}
+
+struct Worker
+{
+    std::thread thread;
+    std::vector<double> latencies; // ns per call of every batch
+    long result = 0;
+};
+
+// Make nCycles calls on random tasks; seed keeps the threads on different sequences.
+static void run_worker(Worker *worker, Task **tasks, int nTasks, int nCycles, unsigned seed,
+                       std::atomic<int> *ready, std::atomic<bool> *go)
+{
+    unsigned rng = seed * 2654435761u + 1;
+    long res = 0;
+    worker->latencies.reserve(nCycles / BATCH_SIZE + 1);
+
+    ready->fetch_add(1);
+    while (!go->load(std::memory_order_acquire))
+        std::this_thread::yield();
+
+    for (int i = 0; i < nCycles; i += BATCH_SIZE)
+    {
+        int n = std::min(BATCH_SIZE, nCycles - i);
+        long long start = now_ns();
+        for (int j = 0; j < n; j++)
+        {
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            res += tasks[rng % nTasks]->run(res);
+        }
+        worker->latencies.push_back((double)(now_ns() - start) / n);
+    }
+    worker->result = res;
+}
+
+static double percentile(const std::vector<double> &sorted, double pct)
+{
+    return sorted[(size_t)(pct / 100 * (sorted.size() - 1) + 0.5)];
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 4)
+    {
+        fprintf(stderr, "Usage: %s <nCycles> [maxThreads] [nTasks]\n", argv[0]);
+        return -1;
+    }
+    int nCycles = atoi(argv[1]);
+    int maxThreads = argc > 2 ? atoi(argv[2]) : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int nTasks = argc > 3 ? atoi(argv[3]) : NPLUGINS * TASKS_PER_PLUGIN;
+    if (nCycles <= 0 || maxThreads <= 0 || nTasks <= 0 || nTasks > NPLUGINS * TASKS_PER_PLUGIN)
+    {
+        fprintf(stderr, "nCycles and maxThreads must be positive, nTasks in [1, %d]\n", NPLUGINS * TASKS_PER_PLUGIN);
+        return -1;
+    }
+
+    void *handles[NPLUGINS] = {nullptr};
+    std::vector<Task *> tasks;
+
+    for (int p = 0; p < NPLUGINS; p++)
+    {
+        char plugin[32];
+        snprintf(plugin, sizeof(plugin), "./libTasks%d.so", p);
+        void *handle = dlopen(plugin, RTLD_LAZY);
+        if (!handle)
+        {
+            perror("Cannot open plugin");
+            return 1;
+        }
+        handles[p] = handle;
+
+        Creator_fty create = (Creator_fty)dlsym(handle, "create");
+        if (!create)
+        {
+            perror("Cannot load symbol create");
+            return 1;
+        }
+        for (int i = 0; i < TASKS_PER_PLUGIN; i++)
+            tasks.push_back(create(i));
+    }
+
+    // Spread the working set over all plugins.
+    std::vector<Task *> workingSet;
+    for (int i = 0; i < nTasks; i++)
+        workingSet.push_back(tasks[(i % NPLUGINS) * TASKS_PER_PLUGIN + i / NPLUGINS]);
+
+    std::vector<int> threadCounts;
+    for (int n = 1; n < maxThreads; n *= 2)
+        threadCounts.push_back(n);
+    threadCounts.push_back(maxThreads);
+
+    printf("%d calls per thread over %d classes in %d plugins, xvcfiopt stats %s\n", nCycles, nTasks, NPLUGINS,
+           __xvcfiopt_get_stats ? "available" : "n/a");
+    printf("%7s %10s %7s | %8s %8s %8s %8s | %10s %10s %10s\n", "threads", "Mcalls/s", "scaling",
+           "p50 ns", "p99 ns", "p99.9 ns", "max ns", "fallbacks", "bypasses", "migrations");
+
+    double baseThroughput = 0;
+    long total = 0;
+    for (int nThreads : threadCounts)
+    {
+        std::vector<Worker> workers(nThreads);
+        std::atomic<int> ready(0);
+        std::atomic<bool> go(false);
+
+        // Opened before the workers start, so that they inherit the counters.
+        PerfCounters counters;
+        perf_counters_open(&counters);
+        for (int t = 0; t < nThreads; t++)
+            workers[t].thread = std::thread(run_worker, &workers[t], workingSet.data(), nTasks, nCycles,
+                                            (unsigned)(nThreads * 1000 + t), &ready, &go);
+        while (ready.load() < nThreads)
+            std::this_thread::yield();
+
+        XvcfiStats before = read_stats();
+        long long start = now_ns();
+        perf_counters_start(&counters);
+        go.store(true, std::memory_order_release);
+        for (auto &worker : workers)
+            worker.thread.join();
+        perf_counters_stop(&counters);
+        long long elapsed = now_ns() - start;
+        XvcfiStats after = read_stats();
+
+        std::vector<double> latencies;
+        for (auto &worker : workers)
+        {
+            latencies.insert(latencies.end(), worker.latencies.begin(), worker.latencies.end());
+            total += worker.result;
+        }
+        std::sort(latencies.begin(), latencies.end());
+
+        double throughput = (double)nCycles * nThreads / elapsed * 1000; // Mcalls/s
+        if (baseThroughput == 0)
+            baseThroughput = throughput;
+
+        printf("%7d %10.2f %7.2f | %8.1f %8.1f %8.1f %8.1f |", nThreads, throughput, throughput / baseThroughput,
+               percentile(latencies, 50), percentile(latencies, 99), percentile(latencies, 99.9), latencies.back());
+        if (__xvcfiopt_get_stats)
+            printf(" %10llu %10llu %10llu\n", (after.misses + after.bypasses) - (before.misses + before.bypasses),
+                   after.bypasses - before.bypasses, after.migrations - before.migrations);
+        else
+            printf(" %10s %10s %10s\n", "n/a", "n/a", "n/a");
+        perf_counters_print(&counters);
+        perf_counters_close(&counters);
+    }
+    printf("Final result: %ld\n", total);
+
+    for (auto task : tasks)
+        delete task;
+    for (auto handle : handles)
+    {
+        if (handle != nullptr)
+            dlclose(handle);
+    }
+
+    return 0;
+}
@@ -1,5 +1,7 @@
 #!/bin/bash
 #bash -x perfrun.sh 1000000
+# For builds under every toolchain, statistics and overhead reports, use
+# ../run_benchmarks.py instead.
 
 NCYCLES=$1
 HEREDIR=`pwd`
@@ -27,6 +29,25 @@ for run in {1..5}; do
 
     cd $HEREDIR/imagefilter
     /usr/bin/time -- ./main $(($NCYCLES / 10))
+
+
+    # 64 classes fit into the verify cache, 1024 overflow it.
+    cd $HEREDIR/multithread
+    CFI_OPTIONS="${CFI_OPTIONS:+${CFI_OPTIONS}:}xvcfi_print_stats=1" /usr/bin/time -- ./main $NCYCLES $(nproc) 64
+
+    cd $HEREDIR/multithread
+    CFI_OPTIONS="${CFI_OPTIONS:+${CFI_OPTIONS}:}xvcfi_print_stats=1" /usr/bin/time -- ./main $NCYCLES $(nproc) 1024
+
+
+    # 4096 signatures overflow the default verify cache five times over.
+    cd $HEREDIR/thrash
+    CFI_OPTIONS="${CFI_OPTIONS:+${CFI_OPTIONS}:}xvcfi_print_stats=1" /usr/bin/time -- ./main $(($NCYCLES * 10)) 4096
+
+    cd $HEREDIR/churn
+    CFI_OPTIONS="${CFI_OPTIONS:+${CFI_OPTIONS}:}xvcfi_print_stats=1" /usr/bin/time -- ./main 100
+
+    cd $HEREDIR/startup
+    /usr/bin/time -- ./main 20
     
     echo "=== Run $run completed ==="
     echo ""
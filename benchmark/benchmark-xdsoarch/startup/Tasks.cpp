@@ -0,0 +1 @@
+../multithread/Tasks.cpp
\ No newline at end of file
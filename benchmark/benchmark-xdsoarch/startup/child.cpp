@@ -0,0 +1,28 @@
+#include "Task.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+// Child of the startup benchmark, linked against n plugins. Prints the
+// CLOCK_MONOTONIC time, in ns, at which main started and at which its first
+// cross-DSO virtual call returned. The launcher (main.cpp) subtracts the time
+// it spawned the child.
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int main()
+{
+    long long mainNs = now_ns();
+    Task *task = create(0); // From the first plugin linked in
+    long res = task->run(1);
+    long long firstCallNs = now_ns();
+
+    printf("%lld %lld %ld\n", mainNs, firstCallNs, res);
+    delete task;
+    return 0;
+}
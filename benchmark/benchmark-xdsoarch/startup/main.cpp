@@ -0,0 +1,225 @@
+#include <algorithm>
+#include <dirent.h>
+#include <spawn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+#include <vector>
+
+// Startup latency benchmark.
+//
+// __cfi_init runs from .preinit_array and builds the whole shadow before
+// main. This launcher spawns every child-<n>x<classes> of the directory, a
+// program linked against n plugins of <classes> classes each (see the
+// Makefile), nRuns times after one warmup run, and reports the medians of:
+//  - exec to main: from posix_spawn to the first line of main;
+//  - exec to first call: to the return of the first cross-DSO vcall;
+//  - exec to exit: until waitpid returns;
+//  - the steps of __cfi_init: flag parsing, shadow allocation, the
+//    dl_iterate_phdr walk, the find_cfi_check_in_dso calls within it, the
+//    shadow install and the xvcfiopt setup. These come from
+//    CFI_OPTIONS=xvcfi_print_init_time=1, which the launcher appends, and
+//    read n/a without xvcfiopt.
+// Build the directory with each toolchain to compare them.
+//
+// Usage: ./main <nRuns> [child...]
+//   The children default to all ./child-* of the directory.
+
+#define NSTEPS 7 // Steps of __cfi_init, in the order of kStepNames
+
+static const char *kStepNames[NSTEPS] = {"init", "flags", "shadow", "walk", "find", "install", "xvcfiopt"};
+
+extern char **environ;
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+struct Sample
+{
+    double mainUs, firstCallUs, exitUs;
+    double steps[NSTEPS]; // us, negative if not reported
+    int dsos;
+};
+
+// Spawn child once; its stdout and stderr both go to one pipe.
+static bool run_child(const char *child, Sample *sample)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        perror("Cannot create pipe");
+        return false;
+    }
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], 1);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], 2);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+
+    char *argv[] = {(char *)child, nullptr};
+    pid_t pid;
+    long long spawnNs = now_ns();
+    int err = posix_spawn(&pid, child, &actions, nullptr, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    close(fds[1]);
+    if (err != 0)
+    {
+        fprintf(stderr, "Cannot spawn %s: %s\n", child, strerror(err));
+        close(fds[0]);
+        return false;
+    }
+
+    std::string output;
+    char buf[4096];
+    ssize_t n;
+    while ((n = read(fds[0], buf, sizeof(buf))) > 0)
+        output.append(buf, n);
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    sample->exitUs = (now_ns() - spawnNs) / 1000.0;
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+        fprintf(stderr, "%s failed:\n%s", child, output.c_str());
+        return false;
+    }
+
+    long long mainNs = 0, firstCallNs = 0;
+    unsigned long long ns[NSTEPS];
+    for (int i = 0; i < NSTEPS; i++)
+        sample->steps[i] = -1;
+    sample->dsos = 0;
+
+    size_t pos = 0;
+    while (pos < output.size())
+    {
+        size_t end = output.find('\n', pos);
+        std::string line = output.substr(pos, end == std::string::npos ? std::string::npos : end - pos);
+        pos = end == std::string::npos ? output.size() : end + 1;
+
+        long res;
+        if (sscanf(line.c_str(),
+                   "CFI: init %llu ns: flags %llu ns, shadow %llu ns, phdr walk %llu ns "
+                   "(find_cfi_check_in_dso %llu ns, %d DSOs), install %llu ns, xvcfiopt %llu ns",
+                   &ns[0], &ns[1], &ns[2], &ns[3], &ns[4], &sample->dsos, &ns[5], &ns[6]) == 8)
+        {
+            for (int i = 0; i < NSTEPS; i++)
+                sample->steps[i] = ns[i] / 1000.0;
+        }
+        else
+            sscanf(line.c_str(), "%lld %lld %ld", &mainNs, &firstCallNs, &res);
+    }
+    if (mainNs == 0)
+    {
+        fprintf(stderr, "%s printed no times:\n%s", child, output.c_str());
+        return false;
+    }
+    sample->mainUs = (mainNs - spawnNs) / 1000.0;
+    sample->firstCallUs = (firstCallNs - spawnNs) / 1000.0;
+    return true;
+}
+
+static double median(std::vector<double> values)
+{
+    std::sort(values.begin(), values.end());
+    return values[values.size() / 2];
+}
+
+// child-<n>x<classes>, ordered by classes then n
+static bool child_less(const std::string &a, const std::string &b)
+{
+    int an = 0, ac = 0, bn = 0, bc = 0;
+    sscanf(a.c_str(), "child-%dx%d", &an, &ac);
+    sscanf(b.c_str(), "child-%dx%d", &bn, &bc);
+    return ac != bc ? ac < bc : an < bn;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "Usage: %s <nRuns> [child...]\n", argv[0]);
+        return -1;
+    }
+    int nRuns = atoi(argv[1]);
+    if (nRuns <= 0)
+    {
+        fprintf(stderr, "nRuns must be positive\n");
+        return -1;
+    }
+
+    std::vector<std::string> children;
+    for (int i = 2; i < argc; i++)
+        children.push_back(argv[i]);
+    if (children.empty())
+    {
+        DIR *dir = opendir(".");
+        struct dirent *entry;
+        while (dir != nullptr && (entry = readdir(dir)) != nullptr)
+        {
+            if (strncmp(entry->d_name, "child-", 6) == 0 && strchr(entry->d_name, '.') == nullptr)
+                children.push_back(entry->d_name);
+        }
+        if (dir != nullptr)
+            closedir(dir);
+        std::sort(children.begin(), children.end(), child_less);
+    }
+    if (children.empty())
+    {
+        fprintf(stderr, "No child-* programs found\n");
+        return -1;
+    }
+
+    // The children inherit the environment, with the init breakdown turned on.
+    const char *options = getenv("CFI_OPTIONS");
+    std::string cfiOptions = options && *options ? std::string(options) + ":" : std::string();
+    setenv("CFI_OPTIONS", (cfiOptions + "xvcfi_print_init_time=1").c_str(), 1);
+
+    printf("%d runs per child, medians in us\n", nRuns);
+    printf("%-12s %5s | %9s %9s %9s |", "child", "DSOs", "main", "1st call", "exit");
+    for (auto name : kStepNames)
+        printf(" %8s", name);
+    printf("\n");
+
+    for (auto &child : children)
+    {
+        std::string path = child.find('/') == std::string::npos ? "./" + child : child;
+        Sample sample;
+        if (!run_child(path.c_str(), &sample))
+            return 1;
+
+        std::vector<double> mainUs, firstCallUs, exitUs, steps[NSTEPS];
+        for (int r = 0; r < nRuns; r++)
+        {
+            if (!run_child(path.c_str(), &sample))
+                return 1;
+            mainUs.push_back(sample.mainUs);
+            firstCallUs.push_back(sample.firstCallUs);
+            exitUs.push_back(sample.exitUs);
+            for (int i = 0; i < NSTEPS; i++)
+                steps[i].push_back(sample.steps[i]);
+        }
+
+        printf("%-12s %5s | %9.1f %9.1f %9.1f |", child.c_str(),
+               sample.dsos ? std::to_string(sample.dsos).c_str() : "n/a", median(mainUs), median(firstCallUs),
+               median(exitUs));
+        for (auto &step : steps)
+        {
+            if (sample.steps[0] < 0)
+                printf(" %8s", "n/a");
+            else
+                printf(" %8.1f", median(step));
+        }
+        printf("\n");
+    }
+
+    return 0;
+}
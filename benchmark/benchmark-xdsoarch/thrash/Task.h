@@ -0,0 +1 @@
+../multithread/Task.h
\ No newline at end of file
@@ -0,0 +1,234 @@
+#include "../../perf_counters.h"
+#include "Task.h"
+#include <algorithm>
+#include <dlfcn.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <vector>
+
+// Verify-cache thrash benchmark.
+//
+// Makes nCalls cross-DSO virtual calls through Task* over nSignatures
+// distinct (type, vtable) pairs, one per class of the libThrash*.so plugins,
+// under three access patterns:
+//  - uniform: every class equally likely;
+//  - zipf:    the class of rank k drawn with probability ~ 1/k^s;
+//  - phase:   uniform over a window of nSignatures/PHASES classes, moving on
+//             to the next disjoint window every SEQ_LEN/PHASES calls.
+// The default verify cache holds 64 groups * 16 slots * 0.75 = 768
+// signatures, so nSignatures above that exercises eviction and re-migration.
+//
+// The classes are drawn ahead into a sequence of SEQ_LEN calls, which the
+// timed loop replays after one untimed pass. Reports per pattern the
+// throughput, verify-cache hit rate, slowpath fallbacks and migrations per
+// second; the cache numbers need CFI_OPTIONS=xvcfi_print_stats=1 and read n/a
+// without xvcfiopt.
+//
+// Usage: ./main <nCalls> [nSignatures] [uniform|zipf|phase|all] [zipfS]
+//   nSignatures defaults to 4096, the pattern to all, zipfS to 0.99.
+
+#ifndef NPLUGINS
+#define NPLUGINS 16
+#endif
+#define SEQ_LEN (1 << 20) // Calls drawn ahead, a power of two
+#define PHASES 8          // Windows of the phase pattern
+
+// Layout of xvcfi_engine_stats_t in the xvcfiopt runtime
+struct XvcfiStats
+{
+    unsigned long long calls;
+    unsigned long long hits;
+    unsigned long long misses;
+    unsigned long long bypasses;
+    unsigned long long migrations;
+};
+
+// Only provided by the xvcfiopt runtime.
+extern "C" void __xvcfiopt_get_stats(XvcfiStats *stats) __attribute__((weak));
+
+typedef Task *(*Creator_fty)(int);
+
+static long long now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static XvcfiStats read_stats()
+{
+    XvcfiStats stats = {0, 0, 0, 0, 0};
+    if (__xvcfiopt_get_stats)
+        __xvcfiopt_get_stats(&stats);
+    return stats;
+}
+
+static unsigned xorshift(unsigned *rng)
+{
+    *rng ^= *rng << 13;
+    *rng ^= *rng >> 17;
+    *rng ^= *rng << 5;
+    return *rng;
+}
+
+// Indices into the working set of SEQ_LEN calls following the pattern.
+static std::vector<int> draw_sequence(const char *pattern, int nSignatures, double zipfS)
+{
+    std::vector<int> seq(SEQ_LEN);
+    unsigned rng = 2025;
+
+    if (strcmp(pattern, "uniform") == 0)
+    {
+        for (auto &index : seq)
+            index = xorshift(&rng) % nSignatures;
+    }
+    else if (strcmp(pattern, "zipf") == 0)
+    {
+        // Inverse CDF over the ranks; the working set is already shuffled, so
+        // the hot classes spread over all plugins.
+        std::vector<double> cdf(nSignatures);
+        double sum = 0;
+        for (int k = 0; k < nSignatures; k++)
+        {
+            sum += 1.0 / pow(k + 1, zipfS);
+            cdf[k] = sum;
+        }
+        for (auto &index : seq)
+        {
+            double u = (double)xorshift(&rng) / 4294967296.0 * sum;
+            index = (int)(std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin());
+            index = std::min(index, nSignatures - 1);
+        }
+    }
+    else
+    {
+        int window = std::max(nSignatures / PHASES, 1);
+        for (int i = 0; i < SEQ_LEN; i++)
+        {
+            int phase = i / (SEQ_LEN / PHASES);
+            seq[i] = (phase * window + xorshift(&rng) % window) % nSignatures;
+        }
+    }
+    return seq;
+}
+
+static void run_pattern(const char *pattern, Task **workingSet, int nSignatures, long nCalls, double zipfS)
+{
+    std::vector<int> indices = draw_sequence(pattern, nSignatures, zipfS);
+    std::vector<Task *> seq(SEQ_LEN);
+    for (int i = 0; i < SEQ_LEN; i++)
+        seq[i] = workingSet[indices[i]];
+
+    long res = 0;
+    for (int i = 0; i < SEQ_LEN; i++)
+        res += seq[i]->run(res);
+
+    PerfCounters counters;
+    perf_counters_open(&counters);
+    XvcfiStats before = read_stats();
+    long long start = now_ns();
+    perf_counters_start(&counters);
+    for (long i = 0; i < nCalls; i++)
+        res += seq[i & (SEQ_LEN - 1)]->run(res);
+    perf_counters_stop(&counters);
+    long long elapsed = now_ns() - start;
+    XvcfiStats after = read_stats();
+
+    printf("%-8s %10.2f |", pattern, (double)nCalls / elapsed * 1000);
+    if (__xvcfiopt_get_stats)
+    {
+        unsigned long long calls = after.calls - before.calls;
+        unsigned long long hits = after.hits - before.hits;
+        unsigned long long migrations = after.migrations - before.migrations;
+        printf(" %8.2f%% %12llu %10llu %12.0f", calls ? 100.0 * hits / calls : 0.0,
+               (after.misses + after.bypasses) - (before.misses + before.bypasses), migrations,
+               migrations / (elapsed / 1e9));
+    }
+    else
+        printf(" %9s %12s %10s %12s", "n/a", "n/a", "n/a", "n/a");
+    printf(" | %ld\n", res);
+    perf_counters_print(&counters);
+    perf_counters_close(&counters);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2 || argc > 5)
+    {
+        fprintf(stderr, "Usage: %s <nCalls> [nSignatures] [uniform|zipf|phase|all] [zipfS]\n", argv[0]);
+        return -1;
+    }
+    long nCalls = atol(argv[1]);
+    int nSignatures = argc > 2 ? atoi(argv[2]) : 4096;
+    const char *pattern = argc > 3 ? argv[3] : "all";
+    double zipfS = argc > 4 ? atof(argv[4]) : 0.99;
+    if (nCalls <= 0 || nSignatures <= 0 || nSignatures > NPLUGINS * TASKS_PER_PLUGIN)
+    {
+        fprintf(stderr, "nCalls must be positive, nSignatures in [1, %d]\n", NPLUGINS * TASKS_PER_PLUGIN);
+        return -1;
+    }
+    const char *patterns[] = {"uniform", "zipf", "phase"};
+    bool known = strcmp(pattern, "all") == 0;
+    for (auto p : patterns)
+        known = known || strcmp(pattern, p) == 0;
+    if (!known)
+    {
+        fprintf(stderr, "Unknown pattern %s\n", pattern);
+        return -1;
+    }
+
+    void *handles[NPLUGINS] = {nullptr};
+    std::vector<Task *> tasks;
+
+    for (int p = 0; p < NPLUGINS; p++)
+    {
+        char plugin[32];
+        snprintf(plugin, sizeof(plugin), "./libThrash%d.so", p);
+        void *handle = dlopen(plugin, RTLD_LAZY);
+        if (!handle)
+        {
+            perror("Cannot open plugin");
+            return 1;
+        }
+        handles[p] = handle;
+
+        Creator_fty create = (Creator_fty)dlsym(handle, "create");
+        if (!create)
+        {
+            perror("Cannot load symbol create");
+            return 1;
+        }
+        for (int i = 0; i < TASKS_PER_PLUGIN; i++)
+            tasks.push_back(create(i));
+    }
+
+    // A shuffled working set, so that neighbouring ranks come from different plugins.
+    std::vector<Task *> workingSet(tasks);
+    unsigned rng = 7;
+    for (int i = (int)workingSet.size() - 1; i > 0; i--)
+        std::swap(workingSet[i], workingSet[xorshift(&rng) % (i + 1)]);
+    workingSet.resize(nSignatures);
+
+    printf("%ld calls over %d signatures in %d plugins, xvcfiopt stats %s\n", nCalls, nSignatures, NPLUGINS,
+           __xvcfiopt_get_stats ? "available" : "n/a");
+    printf("%-8s %10s | %9s %12s %10s %12s | %s\n", "pattern", "Mcalls/s", "hit rate", "fallbacks", "migrations",
+           "migr/s", "result");
+    for (auto p : patterns)
+    {
+        if (strcmp(pattern, "all") == 0 || strcmp(pattern, p) == 0)
+            run_pattern(p, workingSet.data(), nSignatures, nCalls, zipfS);
+    }
+
+    for (auto task : tasks)
+        delete task;
+    for (auto handle : handles)
+    {
+        if (handle != nullptr)
+            dlclose(handle);
+    }
+
+    return 0;
+}
@@ -0,0 +1,128 @@
+// Hardware performance counters around the timed loop of a benchmark, read
+// through perf_event_open(2).
+//
+//   PerfCounters counters;
+//   perf_counters_open(&counters);
+//   perf_counters_start(&counters);
+//   ... timed loop ...
+//   perf_counters_stop(&counters);
+//   perf_counters_print(&counters); // "Perf counters: instructions=... cycles=..."
+//   perf_counters_close(&counters);
+//
+// User-space events only. Threads created after perf_counters_open are
+// counted too. Counters the machine or the kernel does not provide (VMs,
+// perf_event_paranoid > 2) print as n/a; counts are scaled up when the kernel
+// had to multiplex them. PERF_COUNTERS=0 in the environment turns them off.
+
+#ifndef BENCHMARK_PERF_COUNTERS_H
+#define BENCHMARK_PERF_COUNTERS_H
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#define PERF_COUNTERS_NUM 6
+
+#define PERF_CACHE_MISS(cache) \
+    ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+struct PerfCounters
+{
+    int fds[PERF_COUNTERS_NUM];
+};
+
+static const struct
+{
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} kPerfEvents[PERF_COUNTERS_NUM] = {
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"branch-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+    {"L1d-misses", PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_L1D)},
+    {"LLC-misses", PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_LL)},
+    {"iTLB-misses", PERF_TYPE_HW_CACHE, PERF_CACHE_MISS(PERF_COUNT_HW_CACHE_ITLB)},
+};
+
+static void perf_counters_open(PerfCounters *counters)
+{
+    const char *env = getenv("PERF_COUNTERS");
+    bool enabled = env == nullptr || strcmp(env, "0") != 0;
+
+    for (int i = 0; i < PERF_COUNTERS_NUM; i++)
+    {
+        counters->fds[i] = -1;
+        if (!enabled)
+            continue;
+
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = kPerfEvents[i].type;
+        attr.config = kPerfEvents[i].config;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // Each event on its own, so one the PMU lacks does not take the others down.
+        counters->fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+}
+
+static void perf_counters_start(PerfCounters *counters)
+{
+    for (int fd : counters->fds)
+    {
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+static void perf_counters_stop(PerfCounters *counters)
+{
+    for (int fd : counters->fds)
+    {
+        if (fd >= 0)
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    }
+}
+
+static void perf_counters_print(const PerfCounters *counters)
+{
+    printf("Perf counters:");
+    for (int i = 0; i < PERF_COUNTERS_NUM; i++)
+    {
+        uint64_t values[3]; // value, time enabled, time running
+        int fd = counters->fds[i];
+        if (fd < 0 || read(fd, values, sizeof(values)) != sizeof(values) || values[2] == 0)
+        {
+            printf(" %s=n/a", kPerfEvents[i].name);
+            continue;
+        }
+        double scaled = (double)values[0] * values[1] / values[2];
+        printf(" %s=%.0f", kPerfEvents[i].name, scaled);
+    }
+    printf("\n");
+}
+
+static void perf_counters_close(PerfCounters *counters)
+{
+    for (int &fd : counters->fds)
+    {
+        if (fd >= 0)
+            close(fd);
+        fd = -1;
+    }
+}
+
+#endif
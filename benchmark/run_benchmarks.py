@@ -0,0 +1,379 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+Builds and runs the cficheck and xdsoarch benchmarks under several toolchains
+and reports their relative overhead, in place of perfrun-cficheck.sh and
+perfrun-xdsoarch.sh.
+
+Toolchains:
+  base  : llvm14-orig without -fsanitize, the uninstrumented baseline;
+  orig  : llvm14-orig with cross-DSO CFI (build_llvm-xdso-vcfi-orig.sh);
+  opti  : llvm14-opti with cross-DSO CFI (build_llvm-xdso-vcfi-opti.sh);
+  inner : llvm14-orig with VCFI_MODE=INTER (build_llvm-iner-vcfi-orig.sh);
+  opti-l0 : opti run with CFI_OPTIONS=xvcfi_l0_cache=1, the per-thread L0
+          signature cache (not run by default). It has not been measured on
+          calculator and imagefilter yet, and xvcfi_l0_cache stays off by
+          default until it is.
+
+Every suite is built once per toolchain and the build copied aside, so the
+measurement rounds can alternate between toolchains and slow drifts of the
+machine spread over all of them. Each round runs every benchmark once, after
+--warmup discarded rounds, pinned to --cpus.
+
+A run is timed by its "Elapsed time: N microseconds" line when it prints
+one, by the wall clock of the process otherwise. The "Perf counters:" lines
+of perf_counters.h are summed per run and kept next to the time. The output
+directory gets:
+  results.json : settings, raw samples and statistics;
+  results.csv  : one row per benchmark and toolchain, with counter medians;
+  report.txt   : medians and overhead versus base (also printed).
+
+Example:
+  python3 run_benchmarks.py --cycles 10000 --reps 10 --cpus 3
+  python3 run_benchmarks.py --suites xdsoarch --only multithread --cpus 0-7 --max-threads 8
+  CFI_OPTIONS=xvcfi_verify_groups=256 python3 run_benchmarks.py --toolchains base,opti
+  python3 run_benchmarks.py --toolchains base,opti,opti-l0 --only 'calculator|imagefilter'
+"""
+
+import argparse
+import csv
+import datetime
+import json
+import math
+import os
+import platform
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+BASE_FLAGS = "-O2 -fuse-ld=lld -flto -fvisibility=default"
+CFI_FLAGS = BASE_FLAGS + " -fsanitize=cfi-vcall -fsanitize-cfi-cross-dso"
+
+# name -> (toolchain root, CXXFLAGS, VCFI_MODE, CFI_OPTIONS appended at run time)
+TOOLCHAINS = {
+    "base": ("orig", BASE_FLAGS, "XVCFI", ""),
+    "orig": ("orig", CFI_FLAGS, "XVCFI", ""),
+    "opti": ("opti", CFI_FLAGS, "XVCFI", ""),
+    "inner": ("orig", CFI_FLAGS, "INTER", ""),
+    "opti-l0": ("opti", CFI_FLAGS, "XVCFI", "xvcfi_l0_cache=1"),
+}
+
+# Two-sided 95% Student t quantiles by degrees of freedom, 1.96 above 30.
+T95 = [12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+       2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+       2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042]
+
+ELAPSED_RE = re.compile(r"Elapsed time: (\d+) microseconds")
+PERF_RE = re.compile(r"^Perf counters:(.*)$", re.M)
+
+# Hardware counters printed by perf_counters.h, in its order.
+PERF_COUNTERS = ["instructions", "cycles", "branch-misses", "L1d-misses", "LLC-misses", "iTLB-misses"]
+
+
+# CFI_OPTIONS of the benchmarks that report the xvcfiopt counters.
+STATS_OPTIONS = "xvcfi_print_stats=1"
+
+
+def cficheck_benchmarks(n):
+    """The runs of perfrun-cficheck.sh, plus the generate_synthetic.py projects."""
+    root = os.path.join(HERE, "benchmark-cficheck")
+    dirs = ["calculator-%d" % i for i in (1, 2, 3, 4, 8, 10, 20, 30, 40, 50)]
+    dirs += sorted(d for d in os.listdir(root)
+                   if d.startswith("synthetic-") and os.path.isdir(os.path.join(root, d)))
+    return [(d, [str(n * m)], "") for d in dirs for m in (100, 1000)]
+
+
+def xdsoarch_benchmarks(n, max_threads):
+    """The runs of perfrun-xdsoarch.sh, with its CFI_OPTIONS."""
+    return [
+        ("calculator", [str(n * 100)], ""),
+        ("calculator", [str(n * 1000)], ""),
+        ("calculator", [str(n * 10000)], ""),
+        ("logger", [str(n)], ""),
+        ("logger", [str(n * 10)], ""),
+        ("imagefilter", [str(max(n // 10, 1))], ""),
+        ("multithread", [str(n), str(max_threads), "64"], STATS_OPTIONS),
+        ("multithread", [str(n), str(max_threads), "1024"], STATS_OPTIONS),
+        ("thrash", [str(n * 10), "4096"], STATS_OPTIONS),
+        ("churn", ["100"], STATS_OPTIONS),
+        ("startup", ["20"], ""),
+    ]
+
+
+# name -> (directory, extra environment, benchmarks(n, max_threads)). A
+# benchmark is (directory, argv, CFI_OPTIONS appended at run time).
+SUITES = {
+    "cficheck": ("benchmark-cficheck", {}, lambda n, max_threads: cficheck_benchmarks(n)),
+    "xdsoarch": ("benchmark-xdsoarch", {"MIXVCALL": "YES"}, xdsoarch_benchmarks),
+}
+
+
+def parse_cpus(spec):
+    """Parses a CPU list such as "3" or "0,2-5"."""
+    cpus = set()
+    for part in spec.split(","):
+        if "-" in part:
+            lo, hi = part.split("-")
+            cpus.update(range(int(lo), int(hi) + 1))
+        else:
+            cpus.add(int(part))
+    return sorted(cpus)
+
+
+def append_cfi_options(env, cfi_options):
+    """env with cfi_options appended to its CFI_OPTIONS, as the perfrun scripts do."""
+    if not cfi_options:
+        return env
+    env = dict(env)
+    env["CFI_OPTIONS"] = ":".join(o for o in (env.get("CFI_OPTIONS"), cfi_options) if o)
+    return env
+
+
+def toolchain_env(args, toolchain, suite):
+    """Environment of the build_llvm-*.sh script matching the toolchain."""
+    root_name, cxxflags, vcfi_mode, cfi_options = TOOLCHAINS[toolchain]
+    root = args.orig_root if root_name == "orig" else args.opti_root
+    env = append_cfi_options(dict(os.environ), cfi_options)
+    env.update(SUITES[suite][1])
+    env.update({
+        "VCFI_MODE": vcfi_mode,
+        "CLANG_ROOT": root,
+        "PROJECT_CXX": os.path.join(root, "clang++"),
+        "PROJECT_CC": os.path.join(root, "clang"),
+        "CXXFLAGS": cxxflags,
+        "PATH": root + os.pathsep + os.environ.get("PATH", ""),
+    })
+    return env
+
+
+def build(args, toolchain, suite, dest):
+    """
+    Builds a suite with a toolchain and copies it to dest. The build keeps going
+    past errors; benchmarks whose main did not build fail when run.
+    """
+    src = os.path.join(HERE, SUITES[suite][0])
+    env = toolchain_env(args, toolchain, suite)
+    log = os.path.join(args.output, "build-%s-%s.log" % (toolchain, suite))
+    print("Building %s with %s (log: %s)" % (suite, toolchain, log))
+    with open(log, "w") as f:
+        if not args.no_build:
+            subprocess.run(["make", "-f", "common.mk", "clean"], cwd=src, env=env, stdout=f, stderr=subprocess.STDOUT)
+            if subprocess.run(["make", "-k", "-f", "common.mk"], cwd=src, env=env, stdout=f, stderr=subprocess.STDOUT).returncode != 0:
+                print("  build errors, see %s" % log)
+    shutil.copytree(src, dest, symlinks=True)
+    if not args.no_build:
+        subprocess.run(["make", "-f", "common.mk", "clean"], cwd=src, env=env,
+                       stdout=subprocess.DEVNULL, stderr=subprocess.DEVNULL)
+
+
+def run_once(workdir, argv, env, cpus):
+    """
+    Runs one benchmark; returns (microseconds, source of the time, counters) or
+    None on failure. counters maps the names the machine provided to their sums.
+    """
+    if not os.path.exists(os.path.join(workdir, "main")):
+        return None
+    with tempfile.TemporaryFile() as out:
+        start = time.perf_counter()
+        proc = subprocess.run(["./main"] + argv, cwd=workdir, env=env, stdout=out, stderr=subprocess.STDOUT,
+                              preexec_fn=lambda: os.sched_setaffinity(0, cpus))
+        wall = (time.perf_counter() - start) * 1e6
+        if proc.returncode != 0:
+            return None
+        out.seek(0)
+        text = out.read().decode(errors="replace")
+    counters = {}
+    for line in PERF_RE.findall(text):
+        for item in line.split():
+            name, _, value = item.partition("=")
+            if value != "n/a":
+                counters[name] = counters.get(name, 0.0) + float(value)
+    m = ELAPSED_RE.search(text)
+    if m:
+        return float(m.group(1)), "elapsed", counters
+    return wall, "wall", counters
+
+
+def summarize(samples):
+    """Median, mean, sample stddev and 95% confidence interval of the mean."""
+    n = len(samples)
+    mean = statistics.mean(samples)
+    stddev = statistics.stdev(samples) if n > 1 else 0.0
+    t = T95[n - 2] if 1 < n <= len(T95) + 1 else 1.96
+    half = t * stddev / math.sqrt(n) if n > 1 else 0.0
+    return {
+        "n": n,
+        "median": statistics.median(samples),
+        "mean": mean,
+        "stddev": stddev,
+        "min": min(samples),
+        "max": max(samples),
+        "ci95_low": mean - half,
+        "ci95_high": mean + half,
+    }
+
+
+def report(results, toolchains):
+    """Table of medians per toolchain and their overhead versus base."""
+    lines = []
+    others = [t for t in toolchains if t != "base"]
+    header = "%-44s" % "benchmark" + "".join("%14s" % ("%s us" % t) for t in toolchains)
+    if "base" in toolchains:
+        header += "".join("%12s" % ("%s ovh" % t) for t in others)
+    lines.append(header)
+    lines.append("-" * len(header))
+    for bench in results:
+        stats = results[bench]["toolchains"]
+        row = "%-44s" % bench
+        for t in toolchains:
+            row += "%14s" % ("%.0f" % stats[t]["median"] if t in stats else "failed")
+        if "base" in toolchains:
+            for t in others:
+                if t in stats and "base" in stats and stats["base"]["median"] > 0:
+                    row += "%11.1f%%" % ((stats[t]["median"] / stats["base"]["median"] - 1) * 100)
+                else:
+                    row += "%12s" % "n/a"
+        lines.append(row)
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    """Main function to parse arguments, build, run and report."""
+    parser = argparse.ArgumentParser(
+        description="Builds and runs the CFI benchmarks under several toolchains and reports their overhead."
+    )
+    parser.add_argument("--cycles", type=int, default=10000,
+                        help="Base cycle count, scaled per benchmark as in the perfrun scripts (default: 10000)")
+    parser.add_argument("--reps", type=int, default=5, help="Measured rounds (default: 5)")
+    parser.add_argument("--warmup", type=int, default=1, help="Discarded rounds before measuring (default: 1)")
+    parser.add_argument("--cpus", default=None,
+                        help="CPUs to pin the benchmarks to, e.g. 3 or 2-5 (default: the last allowed CPU)")
+    parser.add_argument("--max-threads", type=int, default=len(os.sched_getaffinity(0)),
+                        help="Thread count the multithread sweep goes up to; give it as many --cpus "
+                             "(default: the allowed CPUs, nproc in perfrun-xdsoarch.sh)")
+    parser.add_argument("--toolchains", default="base,orig,opti,inner",
+                        help="Comma-separated subset of %s (default: all)" % ",".join(TOOLCHAINS))
+    parser.add_argument("--suites", default="cficheck,xdsoarch",
+                        help="Comma-separated subset of %s (default: all)" % ",".join(SUITES))
+    parser.add_argument("--orig-root", default=os.path.expanduser("~/toolchain/llvm14-orig/bin"),
+                        help="bin directory of the original LLVM 14 toolchain")
+    parser.add_argument("--opti-root", default=os.path.expanduser("~/toolchain/llvm14-opti/bin"),
+                        help="bin directory of the xvcfiopt LLVM 14 toolchain")
+    parser.add_argument("--only", default=None,
+                        help="Regular expression; only run the benchmarks whose name matches it")
+    parser.add_argument("--no-build", action="store_true",
+                        help="Run the binaries already built in the tree (needs a single toolchain)")
+    parser.add_argument("-o", "--output", default=None,
+                        help="Results directory (default: results/<date-time> next to this script)")
+    args = parser.parse_args()
+
+    toolchains = args.toolchains.split(",")
+    suites = args.suites.split(",")
+    for t in toolchains:
+        if t not in TOOLCHAINS:
+            parser.error("unknown toolchain %s" % t)
+    for s in suites:
+        if s not in SUITES:
+            parser.error("unknown suite %s" % s)
+    if args.no_build and len(toolchains) != 1:
+        parser.error("--no-build needs a single toolchain")
+    if args.reps <= 0 or args.warmup < 0 or args.cycles <= 0 or args.max_threads <= 0:
+        parser.error("--reps, --cycles and --max-threads must be positive, --warmup not negative")
+    cpus = parse_cpus(args.cpus) if args.cpus else [sorted(os.sched_getaffinity(0))[-1]]
+    if "xdsoarch" in suites and args.max_threads > len(cpus):
+        print("warning: multithread runs up to %d threads on %d pinned CPUs" % (args.max_threads, len(cpus)),
+              file=sys.stderr)
+
+    if args.output is None:
+        args.output = os.path.join(HERE, "results", datetime.datetime.now().strftime("%Y%m%d-%H%M%S"))
+    os.makedirs(args.output, exist_ok=True)
+    builds = os.path.join(args.output, "build")
+
+    # Build every (toolchain, suite) aside, then collect the benchmarks of the built ones.
+    plan = []  # (benchmark name, toolchain, workdir, argv, env)
+    for t in toolchains:
+        for s in suites:
+            dest = os.path.join(builds, t, s)
+            build(args, t, s, dest)
+            env = toolchain_env(args, t, s)
+            for d, argv, cfi_options in SUITES[s][2](args.cycles, args.max_threads):
+                bench = "%s/%s %s" % (s, d, " ".join(argv))
+                if args.only is None or re.search(args.only, bench):
+                    plan.append((bench, t, os.path.join(dest, d), argv, append_cfi_options(env, cfi_options)))
+
+    samples = {}  # (benchmark, toolchain) -> [microseconds], None once failed
+    sources = {}
+    counters = {}  # (benchmark, toolchain) -> {counter: [values]}
+    for r in range(args.warmup + args.reps):
+        measured = r >= args.warmup
+        print("=== %s round %d ===" % ("Measured" if measured else "Warmup", r - args.warmup + 1 if measured else r + 1))
+        for bench, t, workdir, argv, env in plan:
+            key = (bench, t)
+            if samples.get(key, []) is None:
+                continue
+            result = run_once(workdir, argv, env, cpus)
+            if result is None:
+                print("  %-44s %-7s failed" % (bench, t))
+                samples[key] = None
+                continue
+            print("  %-44s %-7s %12.0f us" % (bench, t, result[0]))
+            sources[key] = result[1]
+            if measured:
+                samples.setdefault(key, []).append(result[0])
+                for name, value in result[2].items():
+                    counters.setdefault(key, {}).setdefault(name, []).append(value)
+
+    results = {}
+    for bench, t, _, argv, _ in plan:
+        entry = results.setdefault(bench, {"argv": argv, "toolchains": {}})
+        if samples.get((bench, t)):
+            stats = summarize(samples[(bench, t)])
+            stats.update({"time": sources[(bench, t)], "samples": samples[(bench, t)]})
+            stats["counters"] = {name: {"median": statistics.median(values), "samples": values}
+                                 for name, values in counters.get((bench, t), {}).items()}
+            entry["toolchains"][t] = stats
+
+    with open(os.path.join(args.output, "results.json"), "w") as f:
+        json.dump({
+            "settings": {
+                "cycles": args.cycles, "reps": args.reps, "warmup": args.warmup, "cpus": cpus,
+                "max_threads": args.max_threads,
+                "toolchains": toolchains, "suites": suites, "host": platform.node(),
+                "cfi_options": os.environ.get("CFI_OPTIONS", ""),
+                "orig_root": args.orig_root, "opti_root": args.opti_root,
+            },
+            "results": results,
+        }, f, indent=2)
+
+    with open(os.path.join(args.output, "results.csv"), "w", newline="") as f:
+        writer = csv.writer(f)
+        fields = ["n", "median", "mean", "stddev", "min", "max", "ci95_low", "ci95_high"]
+        writer.writerow(["benchmark", "toolchain", "time"] + fields + ["overhead_pct"] + PERF_COUNTERS)
+        for bench, entry in results.items():
+            base = entry["toolchains"].get("base")
+            for t, stats in entry["toolchains"].items():
+                overhead = ""
+                if base is not None and t != "base" and base["median"] > 0:
+                    overhead = "%.2f" % ((stats["median"] / base["median"] - 1) * 100)
+                perf = ["%.0f" % stats["counters"][c]["median"] if c in stats["counters"] else ""
+                        for c in PERF_COUNTERS]
+                writer.writerow([bench, t, stats["time"]] + ["%g" % stats[k] for k in fields] + [overhead] + perf)
+
+    text = report(results, toolchains)
+    with open(os.path.join(args.output, "report.txt"), "w") as f:
+        f.write(text)
+    print()
+    print(text)
+    print("Results written to %s" % args.output)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,51 @@
+#!/bin/bash
+# This script sweeps xvcfiopt runtime parameters through CFI_OPTIONS and runs
+# a perfrun script once for every combination of the given values.
+
+# --- USAGE ---
+# bash sweep-xvcfiopt.sh <perfrun_script> <base_cycles> [<flag>=<v1>,<v2>,...]...
+#
+# Arguments:
+#   <perfrun_script> : The benchmark script to run, e.g. ./perfrun-cficheck.sh
+#   <base_cycles>    : Passed on to the perfrun script.
+#   <flag>=<values>  : An xvcfiopt flag (see xvcfiopt_flags.inc) and a
+#                      comma-separated list of values to try.
+#
+# Example (run inside benchmark-cficheck, built with the opti toolchain):
+#   bash ../sweep-xvcfiopt.sh ./perfrun-cficheck.sh 1000000 \
+#       xvcfi_verify_groups=16,64,256 xvcfi_miss_threshold=50,100,400
+# ---------------
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 <perfrun_script> <base_cycles> [<flag>=<v1>,<v2>,...]..."
+    exit 1
+fi
+
+PERFRUN=$1
+NCYCLES=$2
+shift 2
+
+# Any CFI_OPTIONS from the environment are kept and extended.
+BASE_OPTIONS=${CFI_OPTIONS}
+
+# Recursively expand the remaining <flag>=<values> arguments.
+# $1 is the option string built so far, the rest are flags still to expand.
+sweep(){
+    local options=$1
+    shift
+
+    if [ $# -eq 0 ]; then
+        echo "=== CFI_OPTIONS=${options} ==="
+        CFI_OPTIONS="${options}" bash "$PERFRUN" "$NCYCLES"
+        return
+    fi
+
+    local flag=${1%%=*}
+    local values=${1#*=}
+    shift
+    for value in ${values//,/ }; do
+        sweep "${options:+${options}:}${flag}=${value}" "$@"
+    done
+}
+
+sweep "${BASE_OPTIONS}" "$@"
@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# 把本目录中的修改应用到 llvmorg-14.0.6 源码树（copy_change.sh 的反向操作）
+# 用法: bash apply_change.sh <llvm-project 目录>
+LLVM_DIR="${1:?用法: bash apply_change.sh <llvm-project 目录>}"
+PATCH_DIR="$(cd "$(dirname "$0")" && pwd)"
+
+# 逐个复制 file-list.txt 中的文件
+while read -r status file; do
+    mkdir -p "$LLVM_DIR/$(dirname "$file")"
+    if cp "$PATCH_DIR/$file" "$LLVM_DIR/$file"; then
+        echo "已复制: $file"
+    else
+        echo "复制失败: $file"
+        exit 1
+    fi
+done < "$PATCH_DIR/file-list.txt"
+
+# Options.td 没有整体复制，只把新增的选项追加到末尾（已定义时跳过）
+OPTIONS_TD="$LLVM_DIR/clang/include/clang/Driver/Options.td"
+if ! grep -q "fsanitize_xvcfiopt_image_EQ" "$OPTIONS_TD"; then
+    cat "$PATCH_DIR/clang/include/clang/Driver/Options.td.xvcfiopt" >> "$OPTIONS_TD" || exit 1
+    echo "已追加: clang/include/clang/Driver/Options.td"
+fi
+
+echo "所有文件处理完成"
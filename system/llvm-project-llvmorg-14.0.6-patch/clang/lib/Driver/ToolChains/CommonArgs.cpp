@@ -851,6 +851,10 @@ collectSanitizerRuntimes(const ToolChain &TC, const ArgList &Args,
       else
         SharedRuntimes.push_back("hwasan");
     }
+    // The cfi runtime and the xvcfiopt signature cache in one DSO, so that
+    // the executable and every instrumented DSO share one cache.
+    if (SanArgs.needsCfiRt() && SanArgs.linkRuntimes())
+      SharedRuntimes.push_back("cfi_xvcfiopt");
   }
 
   // The stats_client library is also statically linked into DSOs.
@@ -923,7 +927,8 @@ collectSanitizerRuntimes(const ToolChain &TC, const ArgList &Args,
     RequiredSymbols.push_back("__safestack_init");
   }
   if (!(SanArgs.needsSharedRt() && SanArgs.needsUbsanRt() && SanArgs.linkRuntimes())) {
-    if (SanArgs.needsCfiRt() && SanArgs.linkRuntimes())
+    if (!SanArgs.needsSharedRt() && SanArgs.needsCfiRt() &&
+        SanArgs.linkRuntimes())
       StaticRuntimes.push_back("cfi");
     if (SanArgs.needsCfiDiagRt() && SanArgs.linkRuntimes()) {
       StaticRuntimes.push_back("cfi_diag");
@@ -978,12 +983,28 @@ bool tools::addSanitizerRuntimes(const ToolChain &TC, const ArgList &Args,
     }
   }
 
-  if (SanArgs.needsCfiRt() && SanArgs.linkRuntimes()) {
-    // ADD the --whole-archive flag BEFORE linking the library.
-    CmdArgs.push_back("--whole-archive");
-    CmdArgs.push_back(TC.getCompilerRTArgString(Args, "xvcfiopt"));
-    // ADD the --no-whole-archive flag AFTER linking the library.
-    CmdArgs.push_back("--no-whole-archive");
+  // Like the static cfi runtime, the static xvcfiopt runtime only goes into
+  // executables: DSOs use the __cfi_slowpath of the executable, rather than
+  // a signature cache of their own. With -shared-libsan, cfi_xvcfiopt above
+  // replaces both (the diagnostic runtime has no shared variant).
+  if ((SanArgs.needsCfiRt() || SanArgs.needsCfiDiagRt()) &&
+      SanArgs.linkRuntimes() && !Args.hasArg(options::OPT_shared)) {
+    if (!(SanArgs.needsSharedRt() && SanArgs.needsCfiRt())) {
+      // ADD the --whole-archive flag BEFORE linking the library.
+      CmdArgs.push_back("--whole-archive");
+      CmdArgs.push_back(TC.getCompilerRTArgString(Args, "xvcfiopt"));
+      // ADD the --no-whole-archive flag AFTER linking the library.
+      CmdArgs.push_back("--no-whole-archive");
+    }
+    // Link a prewarmed verify_cache image (xvcfiopt/gen_verify_image.py)
+    // into the executable, if -fsanitize-xvcfiopt-image= names its object
+    // file. The shared runtime finds it among the dynamic symbols.
+    StringRef Image =
+        Args.getLastArgValue(options::OPT_fsanitize_xvcfiopt_image_EQ);
+    if (!Image.empty()) {
+      CmdArgs.push_back(Args.MakeArgString(Image));
+      CmdArgs.push_back("--export-dynamic-symbol=__xvcfiopt_image");
+    }
   }
   for (auto RT : SharedRuntimes)
     addSanitizerRuntime(TC, Args, CmdArgs, RT, true, false);
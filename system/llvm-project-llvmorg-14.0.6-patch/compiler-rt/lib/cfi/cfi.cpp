@@ -42,11 +42,21 @@ typedef ElfW(Dyn) Elf_Dyn;
 #include "sanitizer_common/sanitizer_flag_parser.h"
 #include "ubsan/ubsan_init.h"
 #include "ubsan/ubsan_flags.h"
+#include "xvcfiopt/xvcfiopt_flags.h"
+#include "xvcfiopt/xvcfiopt_init.h"
 
 #ifdef CFI_ENABLE_DIAG
 #include "ubsan/ubsan_handlers.h"
 #endif
 
+// The shared runtime (clang_rt.cfi_xvcfiopt, built by xvcfiopt) is a DSO,
+// which cannot have a .preinit_array.
+#if SANITIZER_CAN_USE_PREINIT_ARRAY && !defined(XVCFIOPT_SHARED_RUNTIME)
+#define CFI_USE_PREINIT_ARRAY 1
+#else
+#define CFI_USE_PREINIT_ARRAY 0
+#endif
+
 using namespace __sanitizer;
 
 namespace __cfi {
@@ -271,12 +281,27 @@ uptr find_cfi_check_in_dso(dl_phdr_info *info) {
   return 0;
 }
 
+// Time spent in the steps of the last shadow update, printed at startup with
+// CFI_OPTIONS=xvcfi_print_init_time=1.
+struct ShadowUpdateTimes {
+  u64 start_ns;   // Allocating the new shadow
+  u64 walk_ns;    // dl_iterate_phdr, find_cfi_check_in_dso included
+  u64 find_ns;    // find_cfi_check_in_dso alone
+  u64 install_ns; // Switching to the new shadow
+  int dsos;
+};
+static ShadowUpdateTimes shadow_update_times;
+
 int dl_iterate_phdr_cb(dl_phdr_info *info, size_t size, void *data) {
+  u64 find_start = MonotonicNanoTime();
   uptr cfi_check = find_cfi_check_in_dso(info);
+  shadow_update_times.find_ns += MonotonicNanoTime() - find_start;
+  shadow_update_times.dsos++;
   if (cfi_check)
     VReport(1, "Module '%s' __cfi_check %zx\n", info->dlpi_name, cfi_check);
 
   ShadowBuilder *b = reinterpret_cast<ShadowBuilder *>(data);
+  uptr module_beg = ~(uptr)0, module_end = 0;
 
   for (int i = 0; i < info->dlpi_phnum; i++) {
     const Elf_Phdr *phdr = &info->dlpi_phdr[i];
@@ -288,6 +313,8 @@ int dl_iterate_phdr_cb(dl_phdr_info *info, size_t size, void *data) {
       // PT_RELRO?
       uptr cur_beg = info->dlpi_addr + phdr->p_vaddr;
       uptr cur_end = cur_beg + phdr->p_memsz;
+      module_beg = Min(module_beg, cur_beg);
+      module_end = Max(module_end, cur_end);
       if (cfi_check) {
         VReport(1, "   %zx .. %zx\n", cur_beg, cur_end);
         b->Add(cur_beg, cur_end, cfi_check);
@@ -296,15 +323,30 @@ int dl_iterate_phdr_cb(dl_phdr_info *info, size_t size, void *data) {
       }
     }
   }
+  if (module_beg < module_end)
+    __xvcfiopt::AddModule(info->dlpi_phdr, info->dlpi_name, module_beg,
+                          module_end);
   return 0;
 }
 
 // Init or update shadow for the current set of loaded libraries.
 void UpdateShadow() {
+  ShadowUpdateTimes &times = shadow_update_times;
+  times = ShadowUpdateTimes();
+  u64 start = MonotonicNanoTime();
   ShadowBuilder b;
   b.Start();
+  u64 started = MonotonicNanoTime();
+  __xvcfiopt::BeginModuleUpdate();
   dl_iterate_phdr(dl_iterate_phdr_cb, &b);
+  u64 walked = MonotonicNanoTime();
   b.Install();
+  times.start_ns = started - start;
+  times.walk_ns = walked - started;
+  times.install_ns = MonotonicNanoTime() - walked;
+  // After the install, whatever xvcfiopt records was checked against the
+  // new shadow.
+  __xvcfiopt::EndModuleUpdate();
 }
 
 void InitShadow() {
@@ -370,8 +412,12 @@ void InitializeFlags() {
   uf->SetDefaults();
 #endif
 
+  __xvcfiopt::Flags *xf = __xvcfiopt::flags();
+  xf->SetDefaults();
+
   FlagParser cfi_parser;
   RegisterCommonFlags(&cfi_parser);
+  __xvcfiopt::RegisterXvcfioptFlags(&cfi_parser, xf);
   cfi_parser.ParseStringFromEnv("CFI_OPTIONS");
 
 #ifdef CFI_ENABLE_DIAG
@@ -410,10 +456,15 @@ __cfi_slowpath_orig(u64 CallSiteTypeId, void *Ptr) {
 
 
 #ifdef CFI_ENABLE_DIAG
-extern "C" SANITIZER_INTERFACE_ATTRIBUTE void
+extern "C" SANITIZER_INTERFACE_ATTRIBUTE void __attribute__((weak))
 __cfi_slowpath_diag(u64 CallSiteTypeId, void *Ptr, void *DiagData) {
   CfiSlowPathCommon(CallSiteTypeId, Ptr, DiagData);
 }
+
+extern "C" SANITIZER_INTERFACE_ATTRIBUTE void
+__cfi_slowpath_diag_orig(u64 CallSiteTypeId, void *Ptr, void *DiagData) {
+  CfiSlowPathCommon(CallSiteTypeId, Ptr, DiagData);
+}
 #endif
 
 static void EnsureInterceptorsInitialized();
@@ -457,21 +508,36 @@ static void EnsureInterceptorsInitialized() {
 }
 
 extern "C" SANITIZER_INTERFACE_ATTRIBUTE
-#if !SANITIZER_CAN_USE_PREINIT_ARRAY
+#if !CFI_USE_PREINIT_ARRAY
 // On ELF platforms, the constructor is invoked using .preinit_array (see below)
 __attribute__((constructor(0)))
 #endif
 void __cfi_init() {
+  u64 init_start = MonotonicNanoTime();
   SanitizerToolName = "CFI";
   InitializeFlags();
+  u64 flags_end = MonotonicNanoTime();
   InitShadow();
+  u64 shadow_end = MonotonicNanoTime();
+  __xvcfiopt::InitAsPlugin();
+  u64 init_end = MonotonicNanoTime();
+
+  if (__xvcfiopt::flags()->xvcfi_print_init_time) {
+    const ShadowUpdateTimes &times = shadow_update_times;
+    Printf("CFI: init %llu ns: flags %llu ns, shadow %llu ns, phdr walk %llu ns "
+           "(find_cfi_check_in_dso %llu ns, %d DSOs), install %llu ns, "
+           "xvcfiopt %llu ns\n",
+           init_end - init_start, flags_end - init_start, times.start_ns,
+           times.walk_ns, times.find_ns, times.dsos, times.install_ns,
+           init_end - shadow_end);
+  }
 
 #ifdef CFI_ENABLE_DIAG
   __ubsan::InitAsPlugin();
 #endif
 }
 
-#if SANITIZER_CAN_USE_PREINIT_ARRAY
+#if CFI_USE_PREINIT_ARRAY
 // On ELF platforms, run cfi initialization before any other constructors.
 // On other platforms we use the constructor attribute to arrange to run our
 // initialization early.
@@ -2,618 +2,1424 @@
 #include <stdint.h>
 #include <stdio.h>
 
-#ifndef d0ebdb30_7057_4381_8bec_14222d7952c4
-#define d0ebdb30_7057_4381_8bec_14222d7952c4
-
+#include "sanitizer_common/sanitizer_common.h"
+#include "sanitizer_common/sanitizer_file.h"
+#include "sanitizer_common/sanitizer_posix.h"
+#include "ubsan/ubsan_handlers.h"
+#include "xvcfiopt_flags.h"
+#include "xvcfiopt_image.h"
+#include "xvcfiopt_init.h"
+
+#include <errno.h>
 #include <immintrin.h>
-#include <stdbool.h>
-#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
 
-#ifndef HM_DEFAULT_N_GROUPS
-#define HM_DEFAULT_N_GROUPS (1)
-#endif
+#include "perfect_hash.h"
+#include "swiss_table.h"
 
-#ifndef HM_LOAD_FACTOR
-#define HM_LOAD_FACTOR (0.75)
-#endif
+using namespace __xvcfiopt;
 
-#ifndef HM_RESIZE_FACTOR
-#define HM_RESIZE_FACTOR (2)
-#endif
+//------------------------Begin: Model-level data structures------------------------------
+#define PAGE_SIZE 4096 // Assuming a page size of 4096 bytes
+// Helper macro to round up to system page size
+#define ROUND_TO_PAGESIZE(size) ((size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
 
-#define HM_GROUP_SIZE (16)
-#define HM_CONTROL_SIZE (16)
+// The geometry can be changed through CFI_OPTIONS, hence the runtime capacity.
+typedef hm_table<HM_GROUP_SIZE, HM_TYPE_RECORD, hm_runtime_capacity> hm_record_map_t;
+typedef hm_table<HM_GROUP_SIZE, HM_TYPE_VERIFY, hm_runtime_capacity> hm_verify_map_t;
+
+// A hashmap for recording VCALL signatures
+#define RECORD_GROUP_NUM 8 // 8 groups for recording, ~1 pages
+
+// A hashmap for verifying VCALL signatures. Mapped page aligned and padded,
+// since it is made read-only between migrations.
+#define VERIFY_GROUP_NUM 64 // 64 groups for verification, ~7 pages
+//-------------------------End: Model-level data structures-------------------------------
+
+// The policy of both tables and of the migration. Copied from
+// hm_default_tuning, and overridden through CFI_OPTIONS.
+static hm_tuning_t hm_tuning = hm_default_tuning;
+
+//-----------------------Begin: Define global variables-----------------------------------
+// The record_cache and the verify_cache are mapped on the first miss, so that
+// processes without cross-DSO vcalls do not pay for them. Until then lookups
+// go to this empty table of one group, which is never written. Zero-filled
+// tables are empty, so only the header needs an initializer.
+static hm_table_storage<hm_verify_map_t, 1> empty_verify_cache = {
+    .table = {.capacity = {0}, .tuning = &hm_tuning},
+};
+//-------------------------End: Define global variables-----------------------------------
+
+//-----------------------Begin: Module epochs---------------------------------------------
+// Verify entries are tagged with the module their vptr points into: the slot
+// of the module in g_module_epochs in the high bits, the epoch of that slot
+// at migration in the low bits. Unloading a module bumps the epoch of its
+// slot, which makes all of its entries stale at once without touching the
+// others. Hits on stale entries are handled as misses, and the eviction hand
+// reclaims them since they are no longer referenced.
+#define MODULE_SLOT_NUM 1024 // Modules whose signatures can be cached at once
+#define MODULE_EPOCH_BITS 21 // Low bits of a tag
+#define MODULE_EPOCH_MASK ((1u << MODULE_EPOCH_BITS) - 1)
+
+static_assert(MODULE_SLOT_NUM <= (1 << (31 - MODULE_EPOCH_BITS)), "tags must fit into the data of an entry");
 
 typedef struct
 {
-    size_t class_id; // a type identifier generated by the clang/llvm;
-    int vptr;        // Using int to store pointer values for better memory efficiency;
-    int data;        // extra information
-} hm_keyv_t;
+    const void *id;            // Program headers, unique among the loaded modules
+    const char *name;          // dlpi_name, owned by the loader
+    uintptr_t begin, end;      // Span of the PT_LOAD segments
+    int slot;                  // Index into g_module_epochs, -1 if none was free
+    bool loaded;               // Got its slot in the last update
+} xvcfi_module_t;
 
-typedef size_t hm_data_t;
-typedef __m128i hm_control_t;
-typedef int8_t hm_metadata_t;
-
-typedef enum // Usage types for this hashmap
+typedef struct
+{
+    xvcfi_module_t modules[MODULE_SLOT_NUM];
+    int n;
+    bool overflow; // More modules were loaded than fit, so none is tagged
+} xvcfi_module_list_t;
+
+// The modules of the last shadow update, and the ones of the update in progress.
+static xvcfi_module_list_t g_module_lists[2];
+static int g_cur_module_list = 0;
+static bool g_module_matched[MODULE_SLOT_NUM]; // Scratch of EndModuleUpdate
+
+static unsigned g_module_epochs[MODULE_SLOT_NUM];
+static bool g_module_slot_used[MODULE_SLOT_NUM];
+static volatile unsigned g_module_unloads = 0; // Bumped whenever modules were unloaded
+
+// Tag of the module the vptr of keyv points into. Signatures only keep the
+// low 32 bits of the vptr, so give up when they fall into several modules.
+// Called during migrations, with the record lock held.
+static bool module_tag_of(hm_keyv_t keyv, int *tag)
 {
-    HM_TYPE_VERIFY = 0, // Only key-value pairs
-    HM_TYPE_RECORD = 1, // with additional data
-} hm_usage_t;
+    const xvcfi_module_list_t *list = &g_module_lists[g_cur_module_list];
+    if (list->overflow)
+        return false;
 
-typedef enum
+    const xvcfi_module_t *found = NULL;
+    for (int i = 0; i < list->n; i++)
+    {
+        const xvcfi_module_t *module = &list->modules[i];
+        if ((uint32_t)((uint32_t)keyv.vptr - (uint32_t)module->begin) < module->end - module->begin)
+        {
+            if (found)
+                return false;
+            found = module;
+        }
+    }
+    if (found == NULL || found->slot < 0)
+        return false;
+
+    *tag = (int)(((unsigned)found->slot << MODULE_EPOCH_BITS) | g_module_epochs[found->slot]);
+    return true;
+}
+
+// Identity of the module registry: equal keys tag every vptr alike.
+static unsigned long long module_set_key()
 {
-    HM_EMPTY1B = 0b10000000,
-    HM_EMPTY8B = 0x8080808080808080UL,
-    HM_DELETED = 0b11111111
-} hm_ctrl_e;
+    const xvcfi_module_list_t *list = &g_module_lists[g_cur_module_list];
+    unsigned long long key = list->overflow ? 1 : 0;
+    for (int i = 0; i < list->n; i++)
+    {
+        const xvcfi_module_t *module = &list->modules[i];
+        unsigned epoch = module->slot < 0 ? 0 : g_module_epochs[module->slot];
+        unsigned long long fields[3] = {module->begin, module->end, ((unsigned long long)(unsigned)module->slot << 32) | epoch};
+        for (int k = 0; k < 3; k++)
+            key = (key ^ fields[k]) * 0x100000001b3ull; // FNV-1a over words
+    }
+    return key;
+}
 
+// Whether the module of a verify entry is still the one it was migrated from.
+static __always_inline bool module_tag_current(int tag)
+{
+    unsigned slot = (unsigned)tag >> MODULE_EPOCH_BITS;
+    return __atomic_load_n(&g_module_epochs[slot], __ATOMIC_RELAXED) == ((unsigned)tag & MODULE_EPOCH_MASK);
+}
+//------------------------End: Module epochs----------------------------------------------
+
+//-----------------Begin: Miss sampling and migration rate limit---------------------------
+// With CFI_OPTIONS=xvcfi_miss_sample_rate=N each thread records about one
+// miss in N, at random so that periodic call patterns do not alias, and
+// counts it N times. The record table then holds samples, and its thresholds
+// are scaled down accordingly. xvcfi_min_migration_interval_us defers
+// migrations that would follow the previous one too closely.
 typedef struct
 {
-    hm_metadata_t meta;
-    int pos;
-} hm_hash_t;
+    int sample_rate;                      // Misses per recorded sample, 1 records all
+    unsigned long long min_interval_ns;   // 0 means no limit
+    unsigned long long last_migration_ns; // End of the last migration
+} xvcfi_miss_policy_t;
+
+static xvcfi_miss_policy_t g_miss_policy = {.sample_rate = 1};
+static THREADLOCAL int t_miss_countdown; // Misses to skip before the next sample
+static THREADLOCAL unsigned t_miss_rng;
+
+// Misses until the next sample, uniform in [1, 2 * sample_rate - 1].
+static int next_miss_countdown()
+{
+    if (t_miss_rng == 0)
+        t_miss_rng = (unsigned)(uintptr_t)&t_miss_rng ^ (unsigned)__rdtsc() ^ 1;
+    t_miss_rng ^= t_miss_rng << 13;
+    t_miss_rng ^= t_miss_rng >> 17;
+    t_miss_rng ^= t_miss_rng << 5;
+    return 1 + (int)(t_miss_rng % (unsigned)(2 * g_miss_policy.sample_rate - 1));
+}
 
-typedef struct // Each group of swiss-table contains 16 slots.
+// Threshold on recorded counts for one in misses. With sampling it takes two
+// samples at least, so that a one-off signature is not promoted on one.
+static int sampled_threshold(int misses)
 {
-    hm_control_t _ctrl;
-    hm_keyv_t keyv[HM_CONTROL_SIZE];
-    hm_hash_t hash[HM_CONTROL_SIZE];
-} hm_group_t;
+    if (g_miss_policy.sample_rate <= 1 || misses == 0)
+        return misses;
+    int samples = misses / g_miss_policy.sample_rate;
+    return samples > 1 ? samples : 1;
+}
 
-#define MAP_EVICT_MIN_COUNT 10 // Minimum number of entries to evict during reduction
-#define MAP_MIGRATE_MIN_FREQ 4 // Minimum value to migrate from record_map
+// Whether the last migration ended too recently for another one.
+static bool migration_rate_limited()
+{
+    if (g_miss_policy.min_interval_ns == 0)
+        return false;
+    return __sanitizer::MonotonicNanoTime() - g_miss_policy.last_migration_ns < g_miss_policy.min_interval_ns;
+}
+//------------------End: Miss sampling and migration rate limit---------------------------
+
+//-----------------Begin: Per-thread L0 cache---------------------------------------------
+// With CFI_OPTIONS=xvcfi_l0_cache=1 every thread keeps the signatures it last
+// validated through the verify_cache in a direct-mapped array, checked before
+// it: a hit there takes neither the hash of the table nor a probe of its
+// shared groups. Entries keep the full vptr, so they match exactly. They stay
+// valid when the verify_cache evicts their signature, and are flushed when a
+// module is unloaded, with g_module_unloads as the epoch.
+#define L0_BITS 4
+#define L0_SIZE (1 << L0_BITS)
 
 typedef struct
 {
-    hm_usage_t cache_type;
-    int oldest_generation; // The generation of the oldest entries;
-    int newest_generation; // Used for eviction entries in verify_cache;
-    int eviction_min_freq; // Used for eviction entries in record_cache;
-} __attribute__((aligned(8))) hm_cache_t;
+    uint64_t type_id;
+    void *ptr; // NULL in a free entry, never a vptr
+} xvcfi_l0_entry_t;
 
-// A swiss-table is a hashmap with a fixed number of groups,
 typedef struct
 {
-    hm_cache_t metainfo;
-
-    int items, size;
-    int n_groups, sentinel;
-    hm_group_t groups[0] __attribute__((aligned(32)));
-} hm_map_t;
+    unsigned epoch; // g_module_unloads when the entries were last flushed
+    xvcfi_l0_entry_t entries[L0_SIZE];
+} xvcfi_l0_t;
 
-//------------------------Begin: Model-level data structures------------------------------
-#define PAGE_SIZE 4096 // Assuming a page size of 4096 bytes
-// Helper macro to round up to system page size
-#define ROUND_TO_PAGESIZE(size) ((size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
-// Helper macro to round down to the nearest power of two
-#define ROUND_DOWN_TO_POW2(x) ((size_t)1 << (63 - __builtin_clzl(x)))
+static bool g_l0_enabled = false;
+static unsigned long long g_l0_hits = 0; // Part of the hits, with xvcfi_print_stats=1
+static THREADLOCAL xvcfi_l0_t t_l0;
 
-// Common layout for a recording and verification hashmap caches
-typedef struct
+static __always_inline xvcfi_l0_entry_t *l0_entry(uint64_t TypeId, void *Ptr)
 {
-    hm_map_t hashmap;                                      // The hashmap instance
-    hm_group_t map_groups[1] __attribute__((aligned(32))); // Adjacent group array
-} hm_cache_layout_t;
+    uint64_t h = (TypeId ^ ((uintptr_t)Ptr >> 3)) * 0x9e3779b97f4a7c15ull;
+    return &t_l0.entries[h >> (64 - L0_BITS)];
+}
 
-// A hashmap for recording VCALL signatures
-#define RECORD_GROUP_NUM 10 // 10 groups for recording, ~1 pages
-typedef struct              // Inherits from hm_cache_layout_t
+static __always_inline bool l0_lookup(uint64_t TypeId, void *Ptr)
 {
-    hm_map_t hashmap;                                                     // The hashmap instance
-    hm_group_t map_groups[RECORD_GROUP_NUM] __attribute__((aligned(32))); // Adjacent group array
-} __attribute__((aligned(PAGE_SIZE))) hm_recordcache_layout_t;
+    unsigned epoch = g_module_unloads;
+    if (__builtin_expect(t_l0.epoch != epoch, 0))
+    {
+        for (int i = 0; i < L0_SIZE; i++)
+            t_l0.entries[i].ptr = NULL;
+        t_l0.epoch = epoch;
+        return false;
+    }
+    xvcfi_l0_entry_t *entry = l0_entry(TypeId, Ptr);
+    return entry->ptr == Ptr && entry->type_id == TypeId;
+}
 
-// A hashmap for verifying VCALL signatures
-#define VERIFY_GROUP_NUM 81 // 81 groups for verification, ~8 pages
-typedef struct              // Inherits from hm_cache_layout_t
+// Called after a verify_cache hit. An unload since the last l0_lookup is
+// caught by the epoch check of the next one.
+static __always_inline void l0_fill(uint64_t TypeId, void *Ptr)
 {
-    hm_map_t hashmap;                                                     // The hashmap instance
-    hm_group_t map_groups[VERIFY_GROUP_NUM] __attribute__((aligned(32))); // Adjacent group array
-} __attribute__((aligned(PAGE_SIZE))) hm_verifycache_layout_t;
+    xvcfi_l0_entry_t *entry = l0_entry(TypeId, Ptr);
+    entry->type_id = TypeId;
+    entry->ptr = Ptr;
+}
+//------------------End: Per-thread L0 cache----------------------------------------------
 
-#endif // d0ebdb30_7057_4381_8bec_14222d7952c4
+//-----------------Begin: Functions for VCFI verification---------------------------------
+static bool track_vcall_signature(hm_record_map_t *map_ref, hm_keyv_t keyv)
+{
+    // Return true if this entry is high frequency
+    return map_ref->track(keyv) > sampled_threshold(hm_tuning.miss_threshold / 5);
+}
 
-#ifndef a723f5ec_ab7b_47ee_9ef7_c78895504a9e
-#define a723f5ec_ab7b_47ee_9ef7_c78895504a9e
-// Include guard to prevent multiple inclusions
-#include <assert.h>
-#include <stdalign.h>
-#include <stdlib.h>
-#include <sys/mman.h>
-#include <unistd.h>
+// The verify_map is read-only, except while it is being changed.
+static void set_verify_map_writable(hm_verify_map_t *verify_map, bool writable)
+{
+    size_t map_bytes = ROUND_TO_PAGESIZE(sizeof(hm_verify_map_t) + verify_map->n_groups() * sizeof(hm_verify_map_t::group_t));
+    mprotect(verify_map, map_bytes, writable ? PROT_READ | PROT_WRITE : PROT_READ);
+}
 
-static __always_inline size_t hash_kvpair(hm_keyv_t vcall_sign)
+// Transfer high frequency entries from src_map to dest_map, tagged with their module
+static bool transfer_high_freq_entries(hm_verify_map_t *verify_map, hm_record_map_t *record_map, int freq)
 {
-    // This simple hash function works because class_id is already a randomized value;
-    return (vcall_sign.class_id ^ (size_t)(vcall_sign.vptr)) & ~0x80ul; // discard the 8th bit
+    set_verify_map_writable(verify_map, true);
+    verify_map->transfer_from(record_map, freq, module_tag_of);
+    set_verify_map_writable(verify_map, false);
+    return true;
 }
 
-static __always_inline bool kvpair_equals(hm_keyv_t kv1, hm_keyv_t kv2)
+// Add all VCALL signatures from recording map to validating map
+static void migrate_vcall_signature(hm_verify_map_t *verify_map, hm_record_map_t *record_map)
 {
-    return (kv1.class_id == kv2.class_id) && (kv1.vptr == kv2.vptr);
+    transfer_high_freq_entries(verify_map, record_map, sampled_threshold(hm_tuning.migrate_min_freq));
+    // Clear the record_map after migration
+    record_map->clear();
 }
+//------------------End: Functions for VCFI verification----------------------------------
 
-#define HASHFUNC hash_kvpair
-#define COMPFUNC kvpair_equals
+using namespace __sanitizer;
 
-//-----------------------Begin: Define global variables-----------------------------------
-// static hm_recordcache_layout_t record_cache __attribute__((aligned(PAGE_SIZE))) = {
-//     .hashmap = {
-//         .metainfo = {.cache_type = HM_TYPE_RECORD, 0, 0, MAP_MIGRATE_MIN_FREQ + 1},
-//         .items = 0,
-//         .size = RECORD_GROUP_NUM * HM_GROUP_SIZE,
-//         .n_groups = RECORD_GROUP_NUM,
-//         .sentinel = 0,
-//     },
-//     .map_groups = {[0 ...(RECORD_GROUP_NUM - 1)] = {._ctrl = {HM_EMPTY8B, HM_EMPTY8B}}},
-// };
-
-// Force the instance to be page-aligned
-// static hm_verifycache_layout_t verify_cache __attribute__((aligned(PAGE_SIZE))) = {
-//     .hashmap = {
-//         .metainfo = {.cache_type = HM_TYPE_VERIFY, 1, 0, 0},
-//         .items = 0,
-//         .size = VERIFY_GROUP_NUM * HM_GROUP_SIZE,
-//         .n_groups = VERIFY_GROUP_NUM,
-//         .sentinel = 0,
-//     },
-//     .map_groups = {[0 ...(VERIFY_GROUP_NUM - 1)] = {._ctrl = {HM_EMPTY8B, HM_EMPTY8B}}},
-// };
-// Include the auto-generated static variable definitions
-#include "cache_init.inc"
-//-------------------------End: Define global variables-----------------------------------
+static volatile bool g_cache_enabled = true;
+static volatile bool g_record_cache_lock = false; // false means unlocked
+static int g_cache_miss_counter = 0;
 
-static inline hm_control_t zero_lowest_n_bytes(hm_control_t _ctrl, hm_metadata_t n) __attribute__((always_inline));
-static inline int hm_pos(size_t hash) __attribute__((always_inline));
-static inline hm_metadata_t hm_meta(size_t hash) __attribute__((always_inline));
-static inline hm_metadata_t hm_group_pos(int idx) __attribute__((always_inline));
-static inline int hm_idx(int group, hm_metadata_t group_pos) __attribute__((always_inline));
-static inline hm_hash_t hm_hash(hm_map_t *map, hm_keyv_t keyv) __attribute__((always_inline));
-static inline bool hm_should_reduce(hm_map_t *map) __attribute__((always_inline));
-static inline uint16_t hm_match_full(hm_map_t *map, int group) __attribute__((always_inline));
-static inline int hm_group(int idx) __attribute__((always_inline));
-static inline int hm_sentinel_group(hm_map_t *map) __attribute__((always_inline));
-static inline int hm_last_group(hm_map_t *map) __attribute__((always_inline));
+// The tables in use, NULL and empty_verify_cache until the first miss.
+static hm_record_map_t *g_record_map = NULL;
+static hm_verify_map_t *g_verify_map = &empty_verify_cache.table;
 
-static inline uint16_t _hm_probe(hm_metadata_t meta, hm_control_t _ctrl) __attribute__((always_inline));
-static inline uint16_t _hm_probe_from(hm_metadata_t group_pos, hm_metadata_t meta, hm_control_t _ctrl) __attribute__((always_inline));
-static inline bool _hm_match_metadata(hm_map_t *map, hm_metadata_t meta, int group, int *match_idx) __attribute__((always_inline));
-static inline bool _hm_match_metadata_from(hm_map_t *map, hm_metadata_t meta, int group, hm_metadata_t group_pos, int *match_idx) __attribute__((always_inline));
-static inline hm_keyv_t *_hm_find_hash(hm_map_t *map, hm_hash_t *hash, hm_keyv_t keyv, int group, hm_metadata_t group_pos) __attribute__((always_inline));
-static inline void _hm_insert_at(hm_map_t *map, int group, hm_metadata_t group_pos, hm_hash_t hash, hm_keyv_t keyv) __attribute__((always_inline));
+// Their geometry, from CFI_OPTIONS.
+static int g_record_groups = RECORD_GROUP_NUM;
+static int g_verify_groups = VERIFY_GROUP_NUM;
 
-// Interfaces for external manipulation
-// static hm_map_t *hm_create(size_t n_groups, hm_usage_t type);
-// static void hm_destroy(hm_map_t *map);
-// static void hm_remove(hm_map_t *map, hm_keyv_t keyv);
+static size_t verify_table_bytes(int n_groups)
+{
+    return ROUND_TO_PAGESIZE(sizeof(hm_verify_map_t) + n_groups * sizeof(hm_verify_map_t::group_t));
+}
 
-static __always_inline hm_keyv_t *hm_find(hm_map_t *map, hm_keyv_t keyv);
-static void hm_insert(hm_map_t *map, hm_keyv_t keyv, hm_data_t data);
-static void hm_clear(hm_map_t *map);
-static bool hm_iterate(hm_map_t *map, int *idx, hm_keyv_t **key_ref);
-static bool transfer_high_freq_entries(hm_map_t *dest_map, hm_map_t *src_map, int freq);
+// Lay out an empty verify table of n_groups groups in zero-filled memory.
+static hm_verify_map_t *init_verify_table(void *mem, int n_groups, hm_verify_map_t::mask_t *ref_bits)
+{
+    hm_verify_map_t *map = (hm_verify_map_t *)mem;
+    map->capacity.groups_mask = n_groups - 1;
+    map->tuning = &hm_tuning;
+    // The referenced bits must stay writable while the table is read-only.
+    map->ref_bits = ref_bits;
+    return map;
+}
 
-alignas(32) static const hm_metadata_t mask[] = {
-    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
-    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1};
+static hm_verify_map_t *alloc_verify_table(int n_groups)
+{
+    void *mem = MmapOrDie(verify_table_bytes(n_groups), "xvcfiopt verify cache");
+    void *ref_bits = MmapOrDie(n_groups * sizeof(hm_verify_map_t::mask_t), "xvcfiopt verify cache bits");
+    return init_verify_table(mem, n_groups, (hm_verify_map_t::mask_t *)ref_bits);
+}
 
-static hm_control_t zero_lowest_n_bytes(hm_control_t _ctrl, hm_metadata_t n)
+static bool verify_cache_mapped()
 {
-    hm_control_t _m = _mm_loadu_si128((hm_control_t *)&mask[16 - n]);
-    return _mm_and_si128(_ctrl, _m);
+    return g_verify_map != &empty_verify_cache.table;
 }
 
-static int hm_pos(size_t hash)
+// Map the verify_cache unless it is mapped already. Called with the record
+// lock held, or from init.
+static void map_verify_cache()
 {
-    // Use the upper 31 bits for position
-    return (int)(hash >> 33);
+    if (verify_cache_mapped())
+        return;
+    hm_verify_map_t *map = alloc_verify_table(g_verify_groups);
+    set_verify_map_writable(map, false);
+    __atomic_store_n(&g_verify_map, map, __ATOMIC_RELEASE);
 }
 
-static hm_metadata_t hm_meta(size_t hash)
+extern "C" void __cfi_slowpath_orig(uint64_t CallSiteTypeId, void *Ptr);
+// Only provided by the diagnostic CFI runtime (clang_rt.cfi_diag).
+extern "C" void __cfi_slowpath_diag_orig(uint64_t CallSiteTypeId, void *Ptr, void *DiagData) __attribute__((weak));
+// Define boundaries of the VTables, use _etext and _edata as they are defined in your linker script.
+extern "C" char __executable_start[]; // __vtable_rodata_start
+extern "C" char _etext[]; // __vtable_rodata_end
+
+//-----------------Begin: Adaptive migration controller-----------------------------------
+// With CFI_OPTIONS=xvcfi_adaptive=1 the migration policy in hm_tuning is
+// re-evaluated every ADAPT_WINDOW_MISSES misses, from the hit ratio and the
+// miss rate observed in that window:
+//  - Phase change: the hit ratio fell ADAPT_PHASE_DROP_PCT points below its
+//    average. Migrate sooner, admit colder signatures, and let the eviction
+//    hand sweep twice as far, so that the new working set gets in quickly.
+//  - Miss storm: most calls miss and misses arrive faster than one every
+//    ADAPT_STORM_CYCLES cycles (e.g. warm-up). Migrate later and only promote
+//    signatures seen more often, so one-off signatures stay out of the
+//    verify_cache and the table is not rewritten back to back.
+//  - Steady state: drift back to the configured policy.
+#define ADAPT_WINDOW_MISSES 64     // Misses per controller evaluation
+#define ADAPT_HIT_BATCH 64         // Hits counted per thread before publishing them
+#define ADAPT_PHASE_DROP_PCT 20    // Hit ratio drop (in points) that signals a phase change
+#define ADAPT_STEADY_HIT_PCT 95    // Hit ratio regarded as steady state
+#define ADAPT_STORM_HIT_PCT 50     // Hit ratio below which a fast miss stream is a storm
+#define ADAPT_STORM_CYCLES 20000   // Average cycles between misses during a storm
+
+typedef struct
+{
+    bool enabled;
+    hm_tuning_t base;                   // The configured policy
+    unsigned long long hits;            // Hits published in the current window
+    unsigned long long misses;          // Misses in the current window
+    unsigned long long window_start;    // TSC at the start of the current window
+    int avg_hit_pct;                    // Moving average of the hit ratio, in percent
+} hm_adaptive_t;
+
+static hm_adaptive_t g_adaptive;
+static THREADLOCAL unsigned t_adaptive_hits; // Hits not yet published to g_adaptive
+
+static __always_inline void adaptive_note_hit()
 {
-    // Use the lower 7 bits for metadata
-    return hash & 0x7f;
+    if (g_adaptive.enabled && ++t_adaptive_hits >= ADAPT_HIT_BATCH)
+    {
+        __atomic_fetch_add(&g_adaptive.hits, t_adaptive_hits, __ATOMIC_RELAXED);
+        t_adaptive_hits = 0;
+    }
 }
 
-static int hm_idx(int group, hm_metadata_t group_pos)
+// Move value one step towards target, scaling by factor 2. Targets are at
+// least 1, e.g. a quarter of xvcfi_miss_threshold=1: a value of 0 would never
+// double back up, and miss_threshold is a divisor.
+static int adaptive_step(int value, int target)
 {
-    return (group * HM_GROUP_SIZE) + group_pos;
+    if (target < 1)
+        target = 1;
+    if (value < target)
+        return (value * 2 < target) ? value * 2 : target;
+    if (value > target)
+        return (value / 2 > target) ? value / 2 : target;
+    return value;
 }
 
-static int hm_group(int idx)
+// Re-evaluate the migration policy. Called with the record lock held.
+static void adaptive_update_policy()
 {
-    return idx / HM_GROUP_SIZE;
+    unsigned long long hits = __atomic_exchange_n(&g_adaptive.hits, 0, __ATOMIC_RELAXED);
+    unsigned long long misses = __atomic_exchange_n(&g_adaptive.misses, 0, __ATOMIC_RELAXED);
+    unsigned long long now = __rdtsc();
+    unsigned long long cycles_per_miss = (now - g_adaptive.window_start) / (misses ? misses : 1);
+    g_adaptive.window_start = now;
+
+    int hit_pct = (int)(hits * 100 / (hits + misses ? hits + misses : 1));
+    const hm_tuning_t *base = &g_adaptive.base;
+
+    if (hit_pct + ADAPT_PHASE_DROP_PCT <= g_adaptive.avg_hit_pct)
+    { // Phase change: the verified working set no longer matches the calls.
+        hm_tuning.miss_threshold = adaptive_step(hm_tuning.miss_threshold, base->miss_threshold / 4);
+        hm_tuning.migrate_min_freq = adaptive_step(hm_tuning.migrate_min_freq, 1);
+        hm_tuning.evict_step = base->evict_step * 2;
+    }
+    else if (hit_pct < ADAPT_STORM_HIT_PCT && cycles_per_miss < ADAPT_STORM_CYCLES)
+    { // Miss storm: batch the migrations and raise the bar for promotion.
+        hm_tuning.miss_threshold = adaptive_step(hm_tuning.miss_threshold, base->miss_threshold * 8);
+        hm_tuning.migrate_min_freq = adaptive_step(hm_tuning.migrate_min_freq, base->migrate_min_freq * 4);
+        hm_tuning.evict_step = base->evict_step;
+    }
+    else if (hit_pct >= ADAPT_STEADY_HIT_PCT)
+    { // Steady state: return to the configured policy.
+        hm_tuning.miss_threshold = adaptive_step(hm_tuning.miss_threshold, base->miss_threshold);
+        hm_tuning.migrate_min_freq = adaptive_step(hm_tuning.migrate_min_freq, base->migrate_min_freq);
+        hm_tuning.evict_step = base->evict_step;
+    }
+
+    g_adaptive.avg_hit_pct = (3 * g_adaptive.avg_hit_pct + hit_pct) / 4;
+    VReport(2, "xvcfiopt: window hit %d%% (avg %d%%), %llu cycles/miss -> miss threshold %d, migrate min freq %d, evict step %d\n",
+            hit_pct, g_adaptive.avg_hit_pct, cycles_per_miss, hm_tuning.miss_threshold,
+            hm_tuning.migrate_min_freq, hm_tuning.evict_step);
 }
+//------------------End: Adaptive migration controller------------------------------------
+
+//-----------------Begin: Verification engines--------------------------------------------
+typedef enum // Selected at startup by CFI_OPTIONS=xvcfi_engine=<name>
+{
+    XVCFI_ENGINE_ORIG = 0,  // The original cross-DSO CFI: shadow + __cfi_check
+    XVCFI_ENGINE_SWISS = 1, // Swiss-table signature cache in front of __cfi_check
+    XVCFI_ENGINE_NUM
+} xvcfi_engine_t;
+
+typedef struct
+{
+    unsigned long long calls;      // Slowpath calls handled by the engine
+    unsigned long long hits;       // Calls validated without reaching __cfi_check
+    unsigned long long misses;     // Calls that reached __cfi_check
+    unsigned long long bypasses;   // Calls that skipped the cache during a migration
+    unsigned long long migrations; // Migrations from record_cache to verify_cache
+} xvcfi_engine_stats_t;
+
+static const char *const g_engine_names[XVCFI_ENGINE_NUM] = {"orig", "swiss"};
+static xvcfi_engine_t g_engine = XVCFI_ENGINE_SWISS;
+static bool g_stats_enabled = false;
+static xvcfi_engine_stats_t g_engine_stats[XVCFI_ENGINE_NUM];
+
+// Counters are only maintained with CFI_OPTIONS=xvcfi_print_stats=1.
+#define ENGINE_STAT_INC(engine, counter)                                               \
+    do                                                                                 \
+    {                                                                                  \
+        if (g_stats_enabled)                                                           \
+            __atomic_fetch_add(&g_engine_stats[engine].counter, 1, __ATOMIC_RELAXED); \
+    } while (0)
+
+//-----------------Begin: Process-shared verify cache--------------------------------------
+// With CFI_OPTIONS=xvcfi_shared_cache=1 the verify_cache is mapped MAP_SHARED
+// at init, and the children forked afterwards, e.g. prefork workers, keep
+// using it: a signature migrated by one of them hits in all the others.
+// Entries hold vptrs and module tags, so they are only meaningful to
+// processes with the same module registry, identified by its key. A child
+// whose modules change detaches to a private table. The creator rekeys the
+// table instead, and children still on the old key detach at their next
+// migration; until then their lookups miss.
+//
+// Processes migrate their own record tables in turn, under a lock in the
+// shared header. Lookups from other processes are guarded by a sequence
+// count, odd during a write, and retried as misses when it changed. The lock
+// of a writer that died is taken over and its table cleared. A lock held for
+// SHARED_LOCK_TIMEOUT_NS, by a writer that hangs or whose pid was reused by
+// another process, is given up on: the processes waiting for it detach.
+typedef struct
+{
+    volatile int owner;                   // Pid of the writing process, the lock
+    volatile unsigned seq;                // Odd while the table is written
+    volatile unsigned long long key;      // module_set_key() of the sharing processes
+    volatile unsigned long long locked_at; // MonotonicNanoTime() when the lock was taken
+    int creator;                          // Pid of the process that mapped the table
+} xvcfi_shared_header_t;
+
+#define SHARED_LOCK_TIMEOUT_NS (100ULL * 1000 * 1000) // 100 ms, migrations take microseconds
 
-static hm_metadata_t hm_group_pos(int idx)
+static xvcfi_shared_header_t *volatile g_shared = NULL;
+static unsigned long long g_shared_key; // module_set_key() of this process
+
+// Map a shared table with the configured geometry: the header page, the
+// table, then its referenced bits. It replaces the lazily mapped verify_cache.
+static void init_shared_cache()
 {
-    return idx % HM_GROUP_SIZE;
+    int n_groups = g_verify_groups;
+    size_t table_bytes = verify_table_bytes(n_groups);
+    size_t bytes = PAGE_SIZE + table_bytes + n_groups * sizeof(hm_verify_map_t::mask_t);
+    uptr res = internal_mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (internal_iserror(res))
+    {
+        Report("WARNING: xvcfi_shared_cache: cannot map %zu bytes, the cache stays private\n", bytes);
+        return;
+    }
+
+    void *mem = (void *)res;
+    xvcfi_shared_header_t *shared = (xvcfi_shared_header_t *)mem;
+    shared->creator = (int)internal_getpid();
+    g_shared_key = shared->key = module_set_key();
+    hm_verify_map_t *map = init_verify_table((char *)mem + PAGE_SIZE, n_groups,
+                                             (hm_verify_map_t::mask_t *)((char *)mem + PAGE_SIZE + table_bytes));
+    set_verify_map_writable(map, false);
+    __atomic_store_n(&g_verify_map, map, __ATOMIC_RELEASE);
+    g_shared = shared;
+    VReport(1, "xvcfiopt: shared verify cache of %zu bytes\n", bytes);
 }
 
-static int hm_sentinel_group(hm_map_t *map)
+static void shared_write_begin(xvcfi_shared_header_t *shared)
 {
-    return hm_group(map->sentinel) + 1;
+    __atomic_store_n(&shared->seq, shared->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
 }
 
-static int hm_last_group(hm_map_t *map)
+static void shared_write_end(xvcfi_shared_header_t *shared)
 {
-    return hm_group(map->size - 1) + 1;
+    __atomic_store_n(&shared->seq, shared->seq + 1, __ATOMIC_RELEASE);
 }
 
-static hm_hash_t hm_hash(hm_map_t *map, hm_keyv_t key)
+static void shared_clear(xvcfi_shared_header_t *shared)
 {
-    hm_hash_t hash;
-    size_t h = HASHFUNC(key);
-    hash.pos = hm_pos(h);
-    hash.meta = hm_meta(h);
-    return hash;
+    shared_write_begin(shared);
+    set_verify_map_writable(g_verify_map, true);
+    g_verify_map->write_abandon(); // Of a writer that died, if any
+    g_verify_map->clear();
+    set_verify_map_writable(g_verify_map, false);
+    shared_write_end(shared);
 }
 
-static bool hm_should_reduce(hm_map_t *map)
+static bool shared_owner_dead(int owner)
 {
-    return map->items >= (HM_LOAD_FACTOR * map->size);
+    int err;
+    return internal_iserror(internal_kill(owner, 0), &err) && err == ESRCH;
 }
 
-static uint16_t hm_match_full(hm_map_t *map, int group)
+// True if the lock has been held for SHARED_LOCK_TIMEOUT_NS.
+static bool shared_lock_stuck(xvcfi_shared_header_t *shared)
 {
-    return ~(_mm_movemask_epi8(map->groups[group]._ctrl));
+    // locked_at is stored before the owner is published.
+    if (!__atomic_load_n(&shared->owner, __ATOMIC_ACQUIRE))
+        return false;
+    return MonotonicNanoTime() - shared->locked_at >= SHARED_LOCK_TIMEOUT_NS;
 }
 
-static uint16_t _hm_probe(hm_metadata_t meta, hm_control_t _ctrl)
+// Take the lock of the shared table, waiting for it if wait is set. False if
+// it is held by another process, or still held after SHARED_LOCK_TIMEOUT_NS.
+static bool shared_lock(xvcfi_shared_header_t *shared, bool wait)
 {
-    hm_control_t _match = _mm_set1_epi8(meta);
-    return _mm_movemask_epi8(_mm_cmpeq_epi8(_match, _ctrl));
+    int pid = (int)internal_getpid();
+    for (;;)
+    {
+        int owner = __atomic_load_n(&shared->owner, __ATOMIC_ACQUIRE);
+        if (owner == 0)
+        {
+            shared->locked_at = MonotonicNanoTime();
+            if (__atomic_compare_exchange_n(&shared->owner, &owner, pid, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+                return true;
+        }
+        else if (shared_owner_dead(owner))
+        {
+            shared->locked_at = MonotonicNanoTime();
+            if (__atomic_compare_exchange_n(&shared->owner, &owner, pid, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+            {
+                // The writer died, maybe halfway through a write.
+                VReport(1, "xvcfiopt: shared verify cache lock taken over from %d\n", owner);
+                if (shared->seq & 1)
+                {
+                    __atomic_store_n(&shared->seq, shared->seq + 1, __ATOMIC_RELAXED);
+                    shared_clear(shared);
+                }
+                return true;
+            }
+        }
+        else if (!wait || shared_lock_stuck(shared))
+        {
+            return false;
+        }
+        internal_sched_yield();
+    }
 }
 
-static uint16_t _hm_probe_from(hm_metadata_t group_pos, hm_metadata_t meta, hm_control_t _ctrl)
+static void shared_unlock(xvcfi_shared_header_t *shared)
 {
-    hm_control_t _match = _mm_set1_epi8(meta);
-    return _mm_movemask_epi8(
-        zero_lowest_n_bytes(
-            _mm_cmpeq_epi8(_match, _ctrl), group_pos));
+    __atomic_store_n(&shared->owner, 0, __ATOMIC_RELEASE);
 }
 
-static bool _hm_match_metadata(hm_map_t *map, hm_metadata_t meta, int group, int *match_idx)
+// Continue with a private table, a copy of the shared one if copy is set.
+// The shared one stays mapped for the lookups still running on it. Called
+// with the record lock held, and with the shared lock to copy.
+static void shared_detach(bool copy, const char *why)
 {
-    hm_metadata_t match_group_pos = _tzcnt_u32(_hm_probe(
-        meta, map->groups[group]._ctrl));
+    hm_verify_map_t *map = alloc_verify_table(g_verify_map->n_groups());
+    if (copy)
+    {
+        hm_verify_map_t::mask_t *ref_bits = map->ref_bits;
+        internal_memcpy(map, g_verify_map, verify_table_bytes(map->n_groups()));
+        map->ref_bits = ref_bits;
+    }
+    // Lookups load the table without a lock: publish it once it is filled
+    // and read-only, like every other table.
+    set_verify_map_writable(map, false);
+    __atomic_store_n(&g_verify_map, map, __ATOMIC_RELEASE);
+    g_shared = NULL;
+    VReport(1, "xvcfiopt: %s, the verify cache is now private\n", why);
+}
 
-    *match_idx = hm_idx(group, match_group_pos);
-    return (match_group_pos < 32) ? true : false;
+// Follow a change of the modules of this process. True if that left this
+// process with an empty table. Called with the record lock held.
+static bool shared_modules_changed()
+{
+    xvcfi_shared_header_t *shared = g_shared;
+    unsigned long long old_key = g_shared_key;
+    g_shared_key = module_set_key();
+    if (shared->key == g_shared_key)
+        return false;
+    if (shared->creator != (int)internal_getpid())
+    {
+        // Entries migrated under the previous modules keep valid tags, the
+        // ones of unloaded modules are stale.
+        bool locked = shared_lock(shared, true);
+        bool copy = locked && shared->key == old_key && !(shared->seq & 1);
+        shared_detach(copy, "modules diverged");
+        if (locked)
+            shared_unlock(shared);
+        return !copy;
+    }
+    if (!shared_lock(shared, true))
+    {
+        shared_detach(false, "shared lock stuck");
+        return true;
+    }
+    shared->key = g_shared_key;
+    shared_clear(shared);
+    shared_unlock(shared);
+    return true;
 }
 
-static bool _hm_match_metadata_from(hm_map_t *map, hm_metadata_t meta, int group,
-                                    hm_metadata_t group_pos, int *match_idx)
+// Lock the shared table for a migration, or detach from it if this process
+// is no longer on its key or its lock is stuck. False if another process
+// holds the lock. Called with the record lock held.
+static bool shared_migration_begin()
 {
-    hm_metadata_t match_group_pos = _tzcnt_u32(_hm_probe_from(
-        group_pos, meta, map->groups[group]._ctrl));
+    xvcfi_shared_header_t *shared = g_shared;
+    if (!shared_lock(shared, false))
+    {
+        if (!shared_lock_stuck(shared))
+            return false;
+        shared_detach(false, "shared lock stuck");
+        return true;
+    }
+    if (shared->key != g_shared_key)
+    {
+        shared_unlock(shared);
+        shared_detach(false, "modules diverged");
+        return true;
+    }
+    shared_write_begin(shared);
+    return true;
+}
 
-    *match_idx = hm_idx(group, match_group_pos);
-    return (match_group_pos < 32) ? true : false;
+static void shared_migration_end(xvcfi_shared_header_t *shared)
+{
+    shared_write_end(shared);
+    shared_unlock(shared);
 }
+//------------------End: Process-shared verify cache---------------------------------------
 
-// Return the hm_keyv_t* for the key-value pair in the hashmap.
-// If the key is not found, return NULL.
-// keyv = _hm_find_hash(map, keyv, ...)
-static hm_keyv_t *_hm_find_hash(hm_map_t *map, hm_hash_t *hash, hm_keyv_t kv, int group, hm_metadata_t group_pos)
+// Migrate the recorded signatures. Called with the record lock held.
+static void run_migration()
 {
-    uint16_t matches = _hm_probe_from(group_pos, hash->meta, map->groups[group]._ctrl);
+    // Another process migrating into the shared table is not waited for.
+    xvcfi_shared_header_t *shared = g_shared;
+    if (shared && !shared_migration_begin())
+        return;
+    shared = g_shared;
 
-    while (matches)
-    {
-        hm_metadata_t match_group_pos = _tzcnt_u32(matches);
+    // Disable cache to begin migration. This write is not thread-safe.
+    g_cache_enabled = false;
 
-        if (COMPFUNC(map->groups[group].keyv[match_group_pos], kv))
-        {
-            return &map->groups[group].keyv[match_group_pos];
-        }
+    // Migrate high-frequency signatures from the recording cache to the verification cache.
+    migrate_vcall_signature(g_verify_map, g_record_map);
+    ENGINE_STAT_INC(XVCFI_ENGINE_SWISS, migrations);
+
+    // Re-enable cache and reset the counter. This write is not thread-safe.
+    g_cache_enabled = true;
+    g_cache_miss_counter = 0;
+    g_miss_policy.last_migration_ns = MonotonicNanoTime();
+    if (shared)
+        shared_migration_end(shared);
+}
 
-        matches = _blsr_u32(matches);
+//-----------------Begin: Frozen snapshot-------------------------------------------------
+// With CFI_OPTIONS=xvcfi_freeze_after_ms=N, once no migration happened for N
+// ms, the signatures of the verify_cache are frozen into a read-only minimal
+// perfect hash table (perfect_hash.h). The slowpaths check it before the
+// verify_cache, and it takes a single slot compare per lookup. New
+// signatures still migrate into the verify_cache, and the next quiet period
+// freezes it again. Threads check for quiet periods every FREEZE_CHECK_HITS
+// verify_cache hits, and hand the freeze to the maintenance thread (see
+// Background migration): its mmap calls and perfect hash build stay off the
+// hit path.
+//
+// Lookups do not announce themselves, so a lookup preempted on a snapshot may
+// resume on it at any time. Replaced snapshots therefore stay mapped, and
+// freezing stops once they take FREEZE_MAX_RETIRED_BYTES. The last snapshot
+// then keeps serving: its entries are checked against the module epochs like
+// the ones of the verify_cache.
+#define FREEZE_CHECK_HITS 4096
+#define FREEZE_MAX_RETIRED_BYTES (4 << 20)
+
+typedef struct
+{
+    unsigned long long after_ns; // 0 means never freeze
+    int generation;              // Of the verify_cache at the last freeze, or -1
+    size_t retired_bytes;        // Mapped by the replaced snapshots, never released
+    volatile bool pending;       // Requested from the maintenance thread
+} xvcfi_freeze_t;
+
+static xvcfi_freeze_t g_freeze = {.after_ns = 0, .generation = -1};
+static ph_table *volatile g_frozen = NULL;
+static unsigned long long g_frozen_hits = 0; // Part of the hits, with xvcfi_print_stats=1
+static THREADLOCAL unsigned t_freeze_hits;
+
+// Publish table, or drop the snapshot for NULL. The previous one stays
+// mapped. Called with the record lock held.
+static void replace_frozen(ph_table *table)
+{
+    ph_table *retired = g_frozen;
+    __atomic_store_n(&g_frozen, table, __ATOMIC_RELEASE);
+    if (retired == NULL)
+        return;
+    g_freeze.retired_bytes += ROUND_TO_PAGESIZE(retired->bytes);
+    if (g_freeze.retired_bytes >= FREEZE_MAX_RETIRED_BYTES)
+        VReport(1, "xvcfiopt: replaced snapshots take %zu bytes, no more freezes\n", g_freeze.retired_bytes);
+}
+
+// Freeze the current signatures of the verify_cache. Called with the record lock held.
+static void freeze_verify_map()
+{
+    // A shared table is read while no other process writes it, a later check
+    // retries otherwise.
+    xvcfi_shared_header_t *shared = g_shared;
+    if (shared && !shared_lock(shared, false))
+        return;
+    if (shared && shared->key != g_shared_key)
+    {
+        shared_unlock(shared);
+        return;
     }
-    // If we reach here, we didn't find the key in the current group.
-    int match_idx;
-    if (_hm_match_metadata_from(map, HM_EMPTY1B, group, group_pos, &match_idx))
-        return NULL;
+    g_freeze.generation = g_verify_map->generation;
 
-    int end_group = hm_sentinel_group(map);
-    while (true)
+    // Entries of unloaded modules are left out.
+    size_t keys_bytes = (g_verify_map->items + 1) * sizeof(hm_keyv_t);
+    hm_keyv_t *keys = (hm_keyv_t *)MmapOrDie(keys_bytes, "xvcfiopt freeze keys");
+    uint32_t n = 0;
+    int idx = 0;
+    hm_keyv_t *key_ref;
+    while (g_verify_map->iterate(&idx, &key_ref))
+    {
+        if (key_ref && module_tag_current(key_ref->data))
+            keys[n++] = *key_ref;
+    }
+    if (shared)
+        shared_unlock(shared);
+
+    ph_table *table = (ph_table *)MmapOrDie(ph_table::bytes_for(n), "xvcfiopt frozen cache");
+    void *scratch = MmapOrDie(ph_table::scratch_bytes(n), "xvcfiopt freeze scratch");
+    bool built = table->build(keys, n, scratch);
+    UnmapOrDie(scratch, ph_table::scratch_bytes(n));
+    UnmapOrDie(keys, keys_bytes);
+    if (!built)
     {
-        group = (group + 1) % end_group;
+        UnmapOrDie(table, ph_table::bytes_for(n));
+        VReport(1, "xvcfiopt: no perfect hash for %u signatures, not frozen\n", n);
+        return;
+    }
 
-        matches = _hm_probe(hash->meta, map->groups[group]._ctrl);
+    mprotect(table, table->bytes, PROT_READ);
+    replace_frozen(table);
+    VReport(1, "xvcfiopt: froze %u signatures into %zu bytes\n", n, table->bytes);
+}
+//------------------End: Frozen snapshot--------------------------------------------------
 
-        while (matches)
-        {
-            hm_metadata_t match_group_pos = _tzcnt_u32(matches);
+static void print_engine_stats()
+{
+    for (int engine = 0; engine < XVCFI_ENGINE_NUM; engine++)
+    {
+        xvcfi_engine_stats_t *stats = &g_engine_stats[engine];
+        if (stats->calls == 0)
+            continue;
+        Printf("xvcfiopt: engine=%s calls=%llu hits=%llu misses=%llu bypasses=%llu migrations=%llu\n",
+                            g_engine_names[engine], stats->calls, stats->hits, stats->misses,
+                            stats->bypasses, stats->migrations);
+        if (engine == XVCFI_ENGINE_SWISS && (g_l0_enabled || g_freeze.after_ns))
+            Printf("xvcfiopt: engine=%s l0_hits=%llu frozen_hits=%llu\n", g_engine_names[engine], g_l0_hits,
+                                g_frozen_hits);
+    }
+}
 
-            if (COMPFUNC(map->groups[group].keyv[match_group_pos], kv))
-            {
-                return &map->groups[group].keyv[match_group_pos];
-            }
+//-----------------Begin: Background migration--------------------------------------------
+// With CFI_OPTIONS=xvcfi_background_migration=1 the slowpath call that
+// triggers a migration only signals a maintenance thread, which runs it
+// (mprotect calls and eviction sweeps included) off the request path. Misses
+// are still recorded until the thread takes the record lock. The same thread
+// freezes the verify_cache with xvcfi_freeze_after_ms. If it cannot be
+// started, migrations and freezes run on the slowpath of a miss.
+typedef struct
+{
+    bool enabled;
+    volatile bool pending; // Requested, and not yet started by the thread
+    uptr pid;              // Process the thread was started in, 0 before
+    bool running;          // The thread of pid was started
+} xvcfi_background_t;
+
+static xvcfi_background_t g_background;
+static Semaphore g_background_wakeup;
 
-            matches = _blsr_u32(matches);
+static void *background_migration_thread(void *arg)
+{
+    while (true)
+    {
+        g_background_wakeup.Wait();
+        while (__atomic_test_and_set(&g_record_cache_lock, __ATOMIC_ACQUIRE))
+            internal_sched_yield();
+        if (g_background.pending)
+        {
+            g_background.pending = false;
+            run_migration();
         }
-        if (_hm_match_metadata(map, HM_EMPTY1B, group, &match_idx))
-            return NULL;
+        if (g_freeze.pending)
+        {
+            g_freeze.pending = false;
+            freeze_verify_map();
+        }
+        __atomic_clear(&g_record_cache_lock, __ATOMIC_RELEASE);
     }
+    return NULL;
 }
 
-/**----------------------------------------------------------------------
- *  Interfaces for external manipulation
- ----------------------------------------------------------------------*/
-// static hm_map_t *hm_create(size_t n_groups, hm_usage_t type)
-// {
-//     assert(false && "hm_create() is not supported in this implementation.");
-//     return NULL;
-// }
+// Start the thread on first use, and again in a forked child, which inherits
+// pending requests but not the thread. False if there is no thread, which is
+// only tried once per process. Called with the record lock held.
+static bool ensure_background_thread()
+{
+    uptr pid = internal_getpid();
+    if (g_background.pid == pid)
+        return g_background.running;
+    g_background.pid = pid;
+    g_background.pending = false;
+    g_freeze.pending = false;
+
+    // Not internal_start_thread: it goes through real_pthread_create, which
+    // only runtimes with interceptors define.
+    pthread_t thread;
+    g_background.running = pthread_create(&thread, NULL, background_migration_thread, NULL) == 0;
+    if (!g_background.running)
+    {
+        Report("WARNING: xvcfiopt: cannot start the maintenance thread, migrating and freezing on the slowpath\n");
+        return false;
+    }
+    pthread_detach(thread);
+    VReport(1, "xvcfiopt: background migration thread started\n");
+    return true;
+}
 
-// static void hm_destroy(hm_map_t *map)
-// {
-//     assert(false && "hm_destroy() is not supported in this implementation.");
-// }
+// A fork() while another thread, e.g. the maintenance one, holds the record
+// lock would leave the child a lock that nothing releases, and a table
+// halfway through a write. The fork waits for the lock instead. The shared
+// table lock is only taken under it, so no write of this process is in
+// flight there either.
+static void record_lock_before_fork()
+{
+    while (__atomic_test_and_set(&g_record_cache_lock, __ATOMIC_ACQUIRE))
+        internal_sched_yield();
+}
 
-// void hm_remove(hm_map_t *map, hm_keyv_t keyv)
-// {
-//     assert(false && "hm_remove() is not supported in this implementation.");
-// }
+static void record_unlock_after_fork()
+{
+    __atomic_clear(&g_record_cache_lock, __ATOMIC_RELEASE);
+}
 
-// Return the element pointer of the key-value pair in the hashmap.
-// If the key is not found, return NULL.
-static hm_keyv_t *hm_find(hm_map_t *map, hm_keyv_t keyv)
+// Hand a migration to the thread, or run it now without one. A request still
+// pending after another miss_threshold misses checks that the thread exists.
+// Called with the record lock held.
+static void request_background_migration()
 {
-    hm_hash_t hash = hm_hash(map, keyv);
-    int idx = hash.pos % map->size;
-    int group = hm_group(idx);
-    hm_metadata_t group_pos = hm_group_pos(idx);
-    return _hm_find_hash(map, &hash, keyv, group, group_pos);
+    // The threshold is at least 1 (see adaptive_step). Guarded anyway: a zero
+    // divisor would raise SIGFPE on the slowpath.
+    int threshold = hm_tuning.miss_threshold > 1 ? hm_tuning.miss_threshold : 1;
+    if (g_background.pending && g_cache_miss_counter % threshold != 0)
+        return;
+
+    if (!ensure_background_thread())
+    {
+        run_migration();
+        return;
+    }
+    if (!g_background.pending)
+    {
+        g_background.pending = true;
+        g_background_wakeup.Post();
+    }
 }
+//------------------End: Background migration---------------------------------------------
 
-void hm_clear(hm_map_t *map)
+// Request a freeze of the verify_cache if it changed since the last freeze
+// and no migration happened for a quiet period. Called every
+// FREEZE_CHECK_HITS hits of a thread.
+static void maybe_freeze()
 {
-    hm_control_t _empty = _mm_set1_epi8(HM_EMPTY1B);
-    int end_group = hm_sentinel_group(map);
+    if (g_verify_map->generation == g_freeze.generation || g_verify_map->items == 0)
+        return;
+    if (g_freeze.retired_bytes >= FREEZE_MAX_RETIRED_BYTES)
+        return;
+    if (MonotonicNanoTime() - g_miss_policy.last_migration_ns < g_freeze.after_ns)
+        return;
+    if (__atomic_test_and_set(&g_record_cache_lock, __ATOMIC_ACQUIRE))
+        return; // Busy, a later check retries
 
-    for (int group = 0; group < end_group; group++)
-        map->groups[group]._ctrl = _empty;
-    map->items = 0;
-    map->sentinel = 0;
+    // Without the thread, the next miss runs the freeze.
+    bool thread = ensure_background_thread();
+    if (!g_freeze.pending)
+    {
+        g_freeze.pending = true;
+        if (thread)
+            g_background_wakeup.Post();
+    }
+    __atomic_clear(&g_record_cache_lock, __ATOMIC_RELEASE);
 }
 
-// Use the FIFO policy to evict the oldest generation from the verify_cache.
-bool _hm_reduce_verify(hm_map_t *map)
+//-----------------Begin: Prewarmed image-------------------------------------------------
+// The image linked into the executable (xvcfiopt_image.h), if any, fills the
+// verify_cache at init with the signatures of the modules loaded by then, and
+// later with the ones of each module it names as that module gets loaded.
+// The entries are relocated against the load address of their module and
+// tagged like migrated ones, so checks against them hit from the first call.
+// CFI_OPTIONS=xvcfi_dump_profile=<path> writes the profiles the images are
+// generated from.
+extern "C" const xvcfi_image_t __xvcfiopt_image __attribute__((weak));
+
+static const xvcfi_image_t *g_image = NULL;
+static const char *g_profile_path = NULL;
+
+// The entries of the image for module, or NULL.
+static const xvcfi_image_module_t *image_module_of(const xvcfi_module_t *module)
 {
-    if (map->n_groups > 0)
+    for (uint32_t m = 0; m < g_image->n_modules; m++)
     {
-        hm_metadata_t group_pos;
-        int group, end_group;
-        uint16_t match_full;
-        int old_gen = map->metainfo.oldest_generation;
+        if (internal_strcmp(g_image->modules[m].name, module->name) == 0)
+            return &g_image->modules[m];
+    }
+    return NULL;
+}
 
-        end_group = hm_sentinel_group(map);
-        for (group = 0; group < end_group; group++)
+// Insert the image signatures of the loaded modules, or only of the ones the
+// last update loaded. Called with the record lock held.
+static void load_image(bool only_loaded)
+{
+    map_verify_cache();
+    xvcfi_shared_header_t *shared = g_shared;
+    if (shared && !shared_lock(shared, true))
+    {
+        shared_detach(false, "shared lock stuck");
+        shared = NULL;
+    }
+    if (shared)
+    {
+        if (shared->key != g_shared_key)
         {
-            match_full = hm_match_full(map, group);
-
-            while (match_full)
-            {
-                group_pos = _tzcnt_u32(match_full);
-
-                if (map->groups[group].keyv[group_pos].data <= old_gen)
-                {
-                    ((hm_metadata_t *)&(map->groups[group]._ctrl))[group_pos] = HM_DELETED;
-                    map->items--;
-                }
-
-                match_full = _blsr_u32(match_full);
-            }
+            shared_unlock(shared);
+            return;
         }
-        map->metainfo.oldest_generation++;
-        assert(map->metainfo.oldest_generation <= map->metainfo.newest_generation &&
-               "oldest_generation should not exceed newest_generation");
+        shared_write_begin(shared);
+    }
+    g_cache_enabled = false;
+    set_verify_map_writable(g_verify_map, true);
+    g_verify_map->generation++; // For the next freeze
 
-        if (map->items == 0)
-            map->sentinel = 0;
+    const xvcfi_module_list_t *list = &g_module_lists[g_cur_module_list];
+    int loaded = 0;
+    for (int i = 0; i < list->n; i++)
+    {
+        const xvcfi_module_t *module = &list->modules[i];
+        const xvcfi_image_module_t *image_module = only_loaded && !module->loaded ? NULL : image_module_of(module);
+        if (image_module == NULL)
+            continue;
+        for (uint32_t e = image_module->first; e < image_module->first + image_module->count; e++)
+        {
+            const xvcfi_image_entry_t *entry = &g_image->entries[e];
+            if (entry->offset >= module->end - module->begin)
+                continue; // Profiled on another build of the module
+            hm_keyv_t keyv = {.class_id = entry->type_id, .vptr = (int)(uint32_t)(module->begin + entry->offset)};
+            int tag;
+            if (!module_tag_of(keyv, &tag))
+                continue;
+            hm_keyv_t *existing = g_verify_map->find(keyv);
+            if (existing)
+                existing->data = tag;
+            else
+                g_verify_map->insert(keyv, tag);
+            loaded++;
+        }
     }
-    return true;
+
+    set_verify_map_writable(g_verify_map, false);
+    g_cache_enabled = true;
+    if (shared)
+        shared_migration_end(shared);
+    if (loaded)
+        VReport(1, "xvcfiopt: %d signatures loaded from the image\n", loaded);
 }
 
-// Use the frequency policy to evict entries in the record_cache.
-bool _hm_reduce_record(hm_map_t *map)
+// Write the signatures of the verify_cache to <xvcfi_dump_profile>.<pid>, one
+// "<type id> <vptr offset> <module name>" line each, in hexadecimal.
+static void dump_profile()
 {
-    if (map->n_groups > 0)
+    char path[4096];
+    internal_snprintf(path, sizeof(path), "%s.%zu", g_profile_path, internal_getpid());
+    fd_t fd = OpenFile(path, WrOnly);
+    if (fd == kInvalidFd)
     {
-        hm_metadata_t group_pos;
-        int group, end_group;
-        uint16_t match_full;
-        int num_evicted = 0; // Number of entries evicted during the reduction
+        Report("WARNING: cannot write the xvcfiopt profile to %s\n", path);
+        return;
+    }
 
-        int min_freq = map->metainfo.eviction_min_freq;
-        while (num_evicted <= MAP_EVICT_MIN_COUNT) // Ensure at least N entries are evicted
+    while (__atomic_test_and_set(&g_record_cache_lock, __ATOMIC_ACQUIRE))
+        internal_sched_yield();
+    const xvcfi_module_list_t *list = &g_module_lists[g_cur_module_list];
+    int n = 0, idx = 0;
+    hm_keyv_t *key_ref;
+    while (g_verify_map->iterate(&idx, &key_ref))
+    {
+        if (key_ref == NULL || !module_tag_current(key_ref->data))
+            continue;
+        int slot = (int)((unsigned)key_ref->data >> MODULE_EPOCH_BITS);
+        for (int i = 0; i < list->n; i++)
         {
-            end_group = hm_sentinel_group(map);
-            for (group = 0; group < end_group; group++)
-            {
-                match_full = hm_match_full(map, group);
+            const xvcfi_module_t *module = &list->modules[i];
+            if (module->slot != slot)
+                continue;
+            char line[4200];
+            uptr len = internal_snprintf(line, sizeof(line), "%llx %x %s\n", (unsigned long long)key_ref->class_id,
+                                         (uint32_t)key_ref->vptr - (uint32_t)module->begin, module->name);
+            WriteToFile(fd, line, len < sizeof(line) ? len : sizeof(line) - 1);
+            n++;
+            break;
+        }
+    }
+    __atomic_clear(&g_record_cache_lock, __ATOMIC_RELEASE);
 
-                while (match_full)
-                {
-                    group_pos = _tzcnt_u32(match_full);
+    CloseFile(fd);
+    VReport(1, "xvcfiopt: %d signatures written to %s\n", n, path);
+}
+//------------------End: Prewarmed image--------------------------------------------------
 
-                    if (map->groups[group].keyv[group_pos].data <= min_freq)
-                    {
-                        ((hm_metadata_t *)&(map->groups[group]._ctrl))[group_pos] = HM_DELETED;
-                        num_evicted++;
-                        map->items--;
-                    }
+namespace __xvcfiopt
+{
+// Allocate an empty table of n_groups groups, laid out like hm_table_storage.
+template <class Table>
+static Table *alloc_cache_table(int n_groups, const char *name)
+{
+    size_t map_bytes = ROUND_TO_PAGESIZE(sizeof(Table) + n_groups * sizeof(typename Table::group_t));
+    Table *map = (Table *)MmapOrDie(map_bytes, name);
 
-                    match_full = _blsr_u32(match_full);
-                }
-            }
-            min_freq *= 2;
-        }
-        if (map->items == 0)
-            map->sentinel = 0;
-    }
+    // MmapOrDie returns zero-filled memory, which is an empty table.
+    map->capacity.groups_mask = n_groups - 1;
+    map->tuning = &hm_tuning;
+    return map;
+}
 
-    return true;
+// The tables index with masks, so their number of groups is a power of two.
+static int round_groups(const char *name, int value)
+{
+    int rounded = 1;
+    while (rounded < value)
+        rounded *= 2;
+    if (rounded != value)
+        Report("WARNING: %s=%d is not a power of two, using %d\n", name, value, rounded);
+    return rounded;
 }
 
-static void _hm_insert_at(hm_map_t *map, int group, hm_metadata_t group_pos, hm_hash_t hash, hm_keyv_t keyv)
+// Clamp a tunable to [min, max] and warn if the requested value was changed.
+static int clamp_tunable(const char *name, int value, int min, int max)
 {
-    int match_idx, match_idx_emp, match_idx_del;
+    int clamped = value < min ? min : (value > max ? max : value);
+    if (clamped != value)
+        Report("WARNING: %s=%d is out of range, using %d\n", name, value, clamped);
+    return clamped;
+}
 
-    bool res1 = _hm_match_metadata_from(map, HM_EMPTY1B, group, group_pos, &match_idx_emp);
-    bool res2 = _hm_match_metadata_from(map, HM_DELETED, group, group_pos, &match_idx_del);
-    if (res1 || res2)
-    {
-        match_idx = (match_idx_emp < match_idx_del) ? match_idx_emp : match_idx_del;
-        group_pos = hm_group_pos(match_idx);
+// Apply the cache geometry and migration policy requested by CFI_OPTIONS.
+static void init_cache_tuning(const Flags *f)
+{
+    hm_tuning.load_factor_pct = clamp_tunable("xvcfi_load_factor", f->xvcfi_load_factor, 10, 95);
+    hm_tuning.compact_pct = clamp_tunable("xvcfi_compact_threshold", f->xvcfi_compact_threshold, 1, 100);
+    hm_tuning.migrate_min_freq = clamp_tunable("xvcfi_migrate_min_freq", f->xvcfi_migrate_min_freq, 0, 1 << 20);
+    hm_tuning.miss_threshold = clamp_tunable("xvcfi_miss_threshold", f->xvcfi_miss_threshold, 1, 1 << 20);
+
+    int record_groups = round_groups("xvcfi_record_groups", clamp_tunable("xvcfi_record_groups", f->xvcfi_record_groups, 2, 1 << 16));
+    int verify_groups = round_groups("xvcfi_verify_groups", clamp_tunable("xvcfi_verify_groups", f->xvcfi_verify_groups, 1, 1 << 20));
+
+    // One reduction must not be able to empty the recording table.
+    int record_max_items = record_groups * HM_GROUP_SIZE * hm_tuning.load_factor_pct / 100;
+    hm_tuning.evict_min_count = clamp_tunable("xvcfi_evict_min_count", f->xvcfi_evict_min_count, 1, record_max_items - 1);
+    hm_tuning.evict_step = clamp_tunable("xvcfi_evict_step", f->xvcfi_evict_step, 1, 1 << 16);
+
+    g_record_groups = record_groups;
+    g_verify_groups = verify_groups;
+
+    VReport(1, "xvcfiopt: record groups %d, verify groups %d, load factor %d%%, compact at %d%%, evict min %d, evict step %d, migrate min freq %d, miss threshold %d\n",
+            record_groups, verify_groups, hm_tuning.load_factor_pct, hm_tuning.compact_pct, hm_tuning.evict_min_count, hm_tuning.evict_step,
+            hm_tuning.migrate_min_freq, hm_tuning.miss_threshold);
+
+    g_miss_policy.sample_rate = clamp_tunable("xvcfi_miss_sample_rate", f->xvcfi_miss_sample_rate, 1, 1 << 16);
+    g_miss_policy.min_interval_ns = (unsigned long long)clamp_tunable("xvcfi_min_migration_interval_us", f->xvcfi_min_migration_interval_us, 0, 1 << 30) * 1000;
+    VReport(1, "xvcfiopt: miss sample rate %d, min migration interval %llu ns\n", g_miss_policy.sample_rate, g_miss_policy.min_interval_ns);
+
+    g_adaptive.enabled = f->xvcfi_adaptive;
+    g_adaptive.base = hm_tuning;
+    g_adaptive.window_start = __rdtsc();
+    g_adaptive.avg_hit_pct = 0;
+}
 
-        ((hm_metadata_t *)&(map->groups[group]._ctrl))[group_pos] = hash.meta;
-        map->groups[group].keyv[group_pos] = keyv;
-        map->groups[group].hash[group_pos] = hash;
+void InitAsPlugin()
+{
+    Flags *f = flags();
 
-        map->items++;
+    int engine;
+    for (engine = 0; engine < XVCFI_ENGINE_NUM; engine++)
+    {
+        if (internal_strcmp(f->xvcfi_engine, g_engine_names[engine]) == 0)
+            break;
+    }
+    if (engine < XVCFI_ENGINE_NUM)
+        g_engine = (xvcfi_engine_t)engine;
+    else
+        Report("WARNING: unknown xvcfi_engine '%s', using '%s'\n", f->xvcfi_engine, g_engine_names[g_engine]);
+    VReport(1, "xvcfiopt: verification engine '%s'\n", g_engine_names[g_engine]);
+
+    g_stats_enabled = f->xvcfi_print_stats;
+    if (g_stats_enabled)
+        Atexit(print_engine_stats);
+
+    init_cache_tuning(f);
+    pthread_atfork(record_lock_before_fork, record_unlock_after_fork, record_unlock_after_fork);
+    g_background.enabled = f->xvcfi_background_migration;
+    g_l0_enabled = f->xvcfi_l0_cache;
+    g_freeze.after_ns = (unsigned long long)clamp_tunable("xvcfi_freeze_after_ms", f->xvcfi_freeze_after_ms, 0, 1 << 30) * 1000000;
+    // After the first shadow update, so that the table is keyed by the modules.
+    if (f->xvcfi_shared_cache)
+        init_shared_cache();
+
+    if (f->xvcfi_dump_profile[0])
+    {
+        g_profile_path = f->xvcfi_dump_profile;
+        Atexit(dump_profile);
+    }
+    if (f->xvcfi_use_image && &__xvcfiopt_image != NULL)
+    {
+        if (__xvcfiopt_image.magic == XVCFI_IMAGE_MAGIC && __xvcfiopt_image.version == XVCFI_IMAGE_VERSION)
+        {
+            g_image = &__xvcfiopt_image;
+            load_image(false);
+        }
+        else
+            Report("WARNING: the xvcfiopt image is not of version %d, ignored\n", XVCFI_IMAGE_VERSION);
+    }
+}
+
+void BeginModuleUpdate()
+{
+    xvcfi_module_list_t *next = &g_module_lists[1 - g_cur_module_list];
+    next->n = 0;
+    next->overflow = false;
+}
 
-        if (match_idx > map->sentinel)
-            map->sentinel = match_idx;
+void AddModule(const void *id, const char *name, uintptr_t begin, uintptr_t end)
+{
+    xvcfi_module_list_t *next = &g_module_lists[1 - g_cur_module_list];
+    if (next->n == MODULE_SLOT_NUM)
+    {
+        next->overflow = true;
         return;
     }
+    next->modules[next->n++] = {.id = id, .name = name, .begin = begin, .end = end, .slot = -1, .loaded = false};
+}
+
+// Index of the module of list with the id and span of module, or -1.
+// Modules are walked in load order, so the search starts after the last match.
+static int find_module(const xvcfi_module_list_t *list, const xvcfi_module_t *module, int from)
+{
+    for (int k = 0; k < list->n; k++)
+    {
+        int i = (from + k) % list->n;
+        const xvcfi_module_t *other = &list->modules[i];
+        if (other->id == module->id && other->begin == module->begin && other->end == module->end)
+            return i;
+    }
+    return -1;
+}
 
-    int end_group = hm_last_group(map);
+void EndModuleUpdate()
+{
+    xvcfi_module_list_t *cur = &g_module_lists[g_cur_module_list];
+    xvcfi_module_list_t *next = &g_module_lists[1 - g_cur_module_list];
 
-    while (true)
+    // Modules that stayed loaded keep their slot.
+    internal_memset(g_module_matched, 0, sizeof(g_module_matched));
+    int from = 0;
+    for (int i = 0; i < next->n; i++)
     {
-        group = (group + 1) % end_group;
+        int j = find_module(cur, &next->modules[i], from);
+        if (j < 0)
+            continue;
+        next->modules[i].slot = cur->modules[j].slot;
+        g_module_matched[j] = true;
+        from = j + 1;
+    }
 
-        res1 = _hm_match_metadata(map, HM_EMPTY1B, group, &match_idx_emp);
-        res2 = _hm_match_metadata(map, HM_DELETED, group, &match_idx_del);
-        if (res1 || res2)
-        {
-            match_idx = (match_idx_emp < match_idx_del) ? match_idx_emp : match_idx_del;
-            group_pos = hm_group_pos(match_idx);
+    // Migrations read the module list and the record table, so wait for the
+    // one in progress.
+    while (__atomic_test_and_set(&g_record_cache_lock, __ATOMIC_ACQUIRE))
+        internal_sched_yield();
 
-            ((hm_metadata_t *)&(map->groups[group]._ctrl))[group_pos] = hash.meta;
-            map->groups[group].hash[group_pos] = hash;
-            map->groups[group].keyv[group_pos] = keyv;
+    // Unloaded modules free their slot for a new epoch.
+    int unloaded = 0;
+    bool wrapped = false;
+    for (int j = 0; j < cur->n; j++)
+    {
+        int slot = cur->modules[j].slot;
+        if (g_module_matched[j] || slot < 0)
+            continue;
+        unsigned epoch = (g_module_epochs[slot] + 1) & MODULE_EPOCH_MASK;
+        __atomic_store_n(&g_module_epochs[slot], epoch, __ATOMIC_RELAXED);
+        g_module_slot_used[slot] = false;
+        wrapped |= epoch == 0;
+        unloaded++;
+    }
 
-            map->items++;
+    int slot = 0;
+    for (int i = 0; i < next->n; i++)
+    {
+        if (next->modules[i].slot >= 0)
+            continue;
+        while (slot < MODULE_SLOT_NUM && g_module_slot_used[slot])
+            slot++;
+        if (slot == MODULE_SLOT_NUM)
+            break; // The remaining modules are not cached
+        next->modules[i].slot = slot;
+        next->modules[i].loaded = true;
+        g_module_slot_used[slot] = true;
+    }
+    g_cur_module_list = 1 - g_cur_module_list;
 
-            if (match_idx > map->sentinel)
-                map->sentinel = match_idx;
-            return;
+    if (unloaded)
+    {
+        // Recorded counts may stem from checks against the unloaded modules,
+        // so they must not be migrated under the new tags.
+        if (g_record_map)
+            g_record_map->clear();
+        g_cache_miss_counter = 0;
+        g_module_unloads++;
+        g_freeze.generation = -1; // Refreeze without the stale entries
+        VReport(2, "xvcfiopt: %d modules unloaded\n", unloaded);
+    }
+    // A shared table is cleared or left when the modules change.
+    bool emptied = g_shared && shared_modules_changed();
+    if (wrapped)
+    {
+        // An epoch came back to a value old entries may still carry.
+        if (!g_shared && verify_cache_mapped())
+        {
+            g_cache_enabled = false;
+            set_verify_map_writable(g_verify_map, true);
+            g_verify_map->clear();
+            set_verify_map_writable(g_verify_map, false);
+            g_cache_enabled = true;
         }
+        replace_frozen(NULL);
     }
+    // A cleared table takes the image again.
+    if (g_image)
+        load_image(!wrapped && !emptied);
+
+    __atomic_clear(&g_record_cache_lock, __ATOMIC_RELEASE);
 }
+} // namespace __xvcfiopt
+//------------------End: Verification engines---------------------------------------------
 
-// map_ref[hash(keyv)] = keyv;
-// Insert a key-value pair into the hashmap.
-void hm_insert(hm_map_t *map_ref, hm_keyv_t keyv, hm_data_t value)
+/**
+ * Records a vcall signature that missed the verification cache, and migrates
+ * high-frequency entries once the miss threshold is reached.
+ *
+ * @param vcall_signature The (type_id, vptr) pair that missed the cache.
+ * @param unloads g_module_unloads before the signature was checked.
+ */
+static __always_inline void record_vcall_signature(hm_keyv_t vcall_signature, unsigned unloads)
 {
-    if (hm_should_reduce(map_ref))
+    // A sampled miss stands for the ones skipped since the last sample.
+    int weight = 1;
+    if (g_miss_policy.sample_rate > 1)
     {
-        assert(map_ref->size > 0 && "hm_map_t::size must be greater than 0");
-        if (map_ref->metainfo.cache_type == HM_TYPE_VERIFY)
-            _hm_reduce_verify(map_ref);
-        else // assert (map_ref->meta.cache_type == HM_TYPE_RECORD);
-            _hm_reduce_record(map_ref);
+        if (--t_miss_countdown > 0)
+            return;
+        t_miss_countdown = next_miss_countdown();
+        weight = g_miss_policy.sample_rate;
     }
 
-    hm_hash_t hash = hm_hash(map_ref, keyv);
-    int idx = hash.pos % map_ref->size;
-    int group = hm_group(idx);
-    hm_metadata_t group_pos = hm_group_pos(idx);
+    g_cache_miss_counter += weight;
+    if (g_adaptive.enabled)
+        __atomic_fetch_add(&g_adaptive.misses, weight, __ATOMIC_RELAXED);
 
-    if (map_ref->metainfo.cache_type == HM_TYPE_VERIFY)
-        keyv.data = map_ref->metainfo.newest_generation;
-    else
-        keyv.data = value;
+    // Attempt to acquire the lock to access the recording table (non-blocking).
+    // test_and_set returns the *previous* value. If it was false (unlocked), the
+    // condition is true and we enter the critical section.
+    if (!__atomic_test_and_set(&g_record_cache_lock, __ATOMIC_ACQUIRE))
+    {
+        // --- Lock Acquired ---
+        if (g_adaptive.enabled && g_adaptive.misses >= ADAPT_WINDOW_MISSES)
+            adaptive_update_policy();
 
-    _hm_insert_at(map_ref, group, group_pos, hash, keyv);
-}
+        // A module was unloaded since the check, which may have been against it.
+        if (unloads != g_module_unloads)
+        {
+            __atomic_clear(&g_record_cache_lock, __ATOMIC_RELEASE);
+            return;
+        }
 
-// Iterate through the hashmap, idx is the current index in the hashmap.
-// *key_ref = map->groups[idx/GROUP_SIZE].keyv[idx%GROUP_SIZE];
-// *value_ref = map->data_arr[idx];
-bool hm_iterate(hm_map_t *map, int *idx, hm_keyv_t **key_ref)
-{
-    if (*idx > map->sentinel)
-        return false;
+        // The first miss maps the tables.
+        if (g_record_map == NULL)
+        {
+            map_verify_cache();
+            g_record_map = alloc_cache_table<hm_record_map_t>(g_record_groups, "xvcfiopt record cache");
+        }
 
-    int group = hm_group(*idx);
-    hm_metadata_t group_pos = hm_group_pos(*idx);
+        bool hot_miss = track_vcall_signature(g_record_map, vcall_signature);
 
-    *key_ref = NULL;
-    if (((hm_metadata_t *)&(map->groups[group]._ctrl))[group_pos] >= 0)
-        *key_ref = &map->groups[group].keyv[group_pos];
+        if ((hot_miss || (g_cache_miss_counter > hm_tuning.miss_threshold)) && !migration_rate_limited())
+        {
+            if (g_background.enabled)
+                request_background_migration();
+            else
+                run_migration();
+        }
+        if (g_freeze.pending && !g_background.running)
+        {
+            g_freeze.pending = false;
+            freeze_verify_map();
+        }
 
-    (*idx)++;
-    return true;
+        // Release the lightweight lock.
+        __atomic_clear(&g_record_cache_lock, __ATOMIC_RELEASE);
+    }
 }
 
-//-----------------Begin: Functions for VCFI verification---------------------------------
-#define CACHE_MISS_THRESHOLD 100 // Trigger migration when this many entries are recorded
-
-static bool track_vcall_signature(hm_map_t *map_ref, hm_keyv_t keyv)
+// Check the caches in front of the verify_cache: the L0 of the thread and the
+// frozen snapshot. Neither changes during migrations.
+static __always_inline bool swiss_front_hit(uint64_t TypeId, void *Ptr, hm_keyv_t vcall_signature)
 {
-    assert(map_ref->metainfo.cache_type == HM_TYPE_RECORD && "hm_map_t::type must be HM_TYPE_MOREDATA");
-    hm_keyv_t *kv = hm_find(map_ref, keyv);
-    if (kv)
+    // Signatures this thread validated recently need no table lookup.
+    if (g_l0_enabled && l0_lookup(TypeId, Ptr))
     {
-        kv->data++;
-        // Return true if this entry is high frequency
-        return kv->data > (CACHE_MISS_THRESHOLD / 5);
+        if (g_stats_enabled)
+            __atomic_fetch_add(&g_l0_hits, 1, __ATOMIC_RELAXED);
     }
     else
     {
-        hm_insert(map_ref, keyv, 1);
-        return false;
+        ph_table *frozen = __atomic_load_n(&g_frozen, __ATOMIC_ACQUIRE);
+        hm_keyv_t *sign = frozen ? frozen->find(vcall_signature) : NULL;
+        if (!sign || !module_tag_current(sign->data))
+            return false;
+        if (g_l0_enabled)
+            l0_fill(TypeId, Ptr);
+        if (g_stats_enabled)
+            __atomic_fetch_add(&g_frozen_hits, 1, __ATOMIC_RELAXED);
     }
+    ENGINE_STAT_INC(XVCFI_ENGINE_SWISS, hits);
+    adaptive_note_hit();
+    return true;
 }
 
-// Transfer high frequency entries from src_map to dest_map
-static bool transfer_high_freq_entries(hm_map_t *verify_map, hm_map_t *record_map, int freq)
+// Look the signature up in the verify_cache. Entries whose module was
+// unloaded since their migration do not count. A write racing the lookup,
+// even one that g_cache_enabled did not keep out, may have torn the entry
+// found, so the lookup only counts if the table did not change meanwhile.
+static __always_inline bool swiss_verify_hit(uint64_t TypeId, void *Ptr, hm_keyv_t vcall_signature)
 {
-    int idx = 0;
-    hm_keyv_t *key_ref;
-
-    // Make the verify_map writable during migration
-    mprotect(verify_map, sizeof(verify_cache), PROT_READ | PROT_WRITE);
-    verify_map->metainfo.newest_generation++;
-    while (hm_iterate(record_map, &idx, &key_ref))
+    // A shared table may be written by another process meanwhile.
+    xvcfi_shared_header_t *shared = g_shared;
+    unsigned shared_seq = 0;
+    if (shared)
     {
-        if (key_ref == NULL)
-            continue; // Skip empty slots
-        if (key_ref->data <= freq)
-            continue; // Skip empty values
-        hm_insert(verify_map, *key_ref, key_ref->data);
+        shared_seq = __atomic_load_n(&shared->seq, __ATOMIC_ACQUIRE);
+        if ((shared_seq & 1) || shared->key != g_shared_key)
+            return false;
     }
-    mprotect(verify_map, sizeof(verify_cache), PROT_READ);
-    return true;
-}
 
-// Add all VCALL signatures from recording map to validating map
-static void migrate_vcall_signature(hm_map_t *verify_map, hm_map_t *record_map)
-{
-    assert(verify_map->metainfo.cache_type == HM_TYPE_VERIFY && "verify_map must be of type HM_TYPE_ONLYKEYV");
-    assert(record_map->metainfo.cache_type == HM_TYPE_RECORD && "record_map must be of type HM_TYPE_MOREDATA");
+    hm_verify_map_t *map = __atomic_load_n(&g_verify_map, __ATOMIC_ACQUIRE);
+    unsigned seq = map->read_begin();
+    hm_keyv_t *sign = map->find(vcall_signature);
+    if (!sign || !module_tag_current(sign->data) || !map->read_valid(seq))
+        return false;
+    if (shared && __atomic_load_n(&shared->seq, __ATOMIC_RELAXED) != shared_seq)
+        return false;
 
-    transfer_high_freq_entries(verify_map, record_map, MAP_MIGRATE_MIN_FREQ);
-    // Clear the record_map after migration
-    hm_clear(record_map);
+    map->touch(sign);
+    if (g_l0_enabled)
+        l0_fill(TypeId, Ptr);
+    ENGINE_STAT_INC(XVCFI_ENGINE_SWISS, hits);
+    adaptive_note_hit();
+    if (g_freeze.after_ns && ++t_freeze_hits % FREEZE_CHECK_HITS == 0)
+        maybe_freeze();
+    return true;
 }
-//------------------End: Functions for VCFI verification----------------------------------
-#endif // a723f5ec_ab7b_47ee_9ef7_c78895504a9e
-
-static volatile bool g_cache_enabled = true;
-static volatile bool g_record_cache_lock = false; // false means unlocked
-static int g_cache_miss_counter = 0;
-
-extern "C" void __cfi_slowpath_orig(uint64_t CallSiteTypeId, void *Ptr);
-// Define boundaries of the VTables, use _etext and _edata as they are defined in your linker script.
-extern "C" char __executable_start[]; // __vtable_rodata_start
-extern "C" char _etext[]; // __vtable_rodata_end
 
 /**
  * Checks if the vcall signature (type_id, vptr) exists in the verification
@@ -623,53 +1429,126 @@ extern "C" char _etext[]; // __vtable_rodata_end
  * @param type_id The type identifier for the vcall class.
  * @param vptr The virtual pointer value for the vtable pointer.
  */
-extern "C" void __cfi_slowpath(uint64_t TypeId, void *Ptr)
+static __always_inline void swiss_slowpath(uint64_t TypeId, void *Ptr)
 {
+    // VCall signature to check in the verification cache.
+    hm_keyv_t vcall_signature = {.class_id = TypeId, .vptr = (int)(long)Ptr};
+
+    if (swiss_front_hit(TypeId, Ptr, vcall_signature))
+        return;
+
     // If cache is temporarily disabled for migration, fallback to original slowpath.
     if (!g_cache_enabled)
     { // Reading the non-atomic, volatile bool
+        ENGINE_STAT_INC(XVCFI_ENGINE_SWISS, bypasses);
         __cfi_slowpath_orig(TypeId, Ptr);
         return;
     }
 
-    // VCall signature to check in the verification cache.
-    hm_keyv_t vcall_signature = {.class_id = TypeId, .vptr = (int)(long)Ptr};
-
-    // Verify with the cache table.
-    hm_keyv_t *sign = hm_find(&verify_cache.hashmap, vcall_signature);
-
     // On cache hit, the call is considered valid. Return immediately.
-    if (sign)
+    if (swiss_verify_hit(TypeId, Ptr, vcall_signature))
         return;
 
     // --- Cache Miss ---
-    g_cache_miss_counter++;
+    ENGINE_STAT_INC(XVCFI_ENGINE_SWISS, misses);
+    // The check follows the recording, so the current modules are vouched for.
+    record_vcall_signature(vcall_signature, g_module_unloads);
 
-    // Attempt to acquire the lock to access the recording table (non-blocking).
-    // test_and_set returns the *previous* value. If it was false (unlocked), the
-    // condition is true and we enter the critical section.
-    if (!__atomic_test_and_set(&g_record_cache_lock, __ATOMIC_ACQUIRE))
+    // Fallback to the original slow path for this VCall.
+    __cfi_slowpath_orig(TypeId, Ptr);
+}
+
+// Run the original check, reporting failures through ubsan if the diagnostic
+// runtime is linked in, and trapping otherwise.
+static __always_inline void cfi_slowpath_diag_orig(uint64_t TypeId, void *Ptr, void *DiagData)
+{
+    if (__cfi_slowpath_diag_orig)
+        __cfi_slowpath_diag_orig(TypeId, Ptr, DiagData);
+    else
+        __cfi_slowpath_orig(TypeId, Ptr);
+}
+
+/**
+ * Diagnostic counterpart of swiss_slowpath, for modules built without
+ * -fsanitize-trap. Cache hits return without consulting the diagnostic path.
+ * Misses are checked by the original slowpath first, and only recorded if
+ * no CFI failure has been reported for the call site.
+ *
+ * @param type_id The type identifier for the vcall class.
+ * @param vptr The virtual pointer value for the vtable pointer.
+ * @param diag_data The CFICheckFailData of the call site.
+ */
+static __always_inline void swiss_slowpath_diag(uint64_t TypeId, void *Ptr, void *DiagData)
+{
+    hm_keyv_t vcall_signature = {.class_id = TypeId, .vptr = (int)(long)Ptr};
+    if (swiss_front_hit(TypeId, Ptr, vcall_signature))
+        return;
+
+    if (!g_cache_enabled)
     {
-        // --- Lock Acquired ---
-        bool hot_miss = track_vcall_signature(&record_cache.hashmap, vcall_signature);
+        ENGINE_STAT_INC(XVCFI_ENGINE_SWISS, bypasses);
+        cfi_slowpath_diag_orig(TypeId, Ptr, DiagData);
+        return;
+    }
 
-        if (hot_miss || (g_cache_miss_counter > CACHE_MISS_THRESHOLD))
-        {
-            // Disable cache to begin migration. This write is not thread-safe.
-            g_cache_enabled = false;
+    if (swiss_verify_hit(TypeId, Ptr, vcall_signature))
+        return;
 
-            // Migrate high-frequency signatures from the recording cache to the verification cache.
-            migrate_vcall_signature(&verify_cache.hashmap, &record_cache.hashmap);
+    // --- Cache Miss ---
+    ENGINE_STAT_INC(XVCFI_ENGINE_SWISS, misses);
+    unsigned unloads = g_module_unloads;
+    cfi_slowpath_diag_orig(TypeId, Ptr, DiagData);
+
+    // In recover mode a failed check returns here. ubsan disables the source
+    // location of a call site once it reported a failure there, so never
+    // promote signatures seen at such call sites.
+    if (DiagData && reinterpret_cast<__ubsan::CFICheckFailData *>(DiagData)->Loc.isDisabled())
+        return;
 
-            // Re-enable cache and reset the counter. This write is not thread-safe.
-            g_cache_enabled = true;
-            g_cache_miss_counter = 0;
-        }
+    record_vcall_signature(vcall_signature, unloads);
+}
 
-        // Release the lightweight lock.
-        __atomic_clear(&g_record_cache_lock, __ATOMIC_RELEASE);
+extern "C" SANITIZER_INTERFACE_ATTRIBUTE void __cfi_slowpath(uint64_t TypeId, void *Ptr)
+{
+    switch (g_engine)
+    {
+    case XVCFI_ENGINE_ORIG:
+        ENGINE_STAT_INC(XVCFI_ENGINE_ORIG, calls);
+        ENGINE_STAT_INC(XVCFI_ENGINE_ORIG, misses);
+        __cfi_slowpath_orig(TypeId, Ptr);
+        break;
+    default:
+        ENGINE_STAT_INC(XVCFI_ENGINE_SWISS, calls);
+        swiss_slowpath(TypeId, Ptr);
+        break;
     }
+}
 
-    // Fallback to the original slow path for this VCall.
-    __cfi_slowpath_orig(TypeId, Ptr);
+extern "C" SANITIZER_INTERFACE_ATTRIBUTE void __cfi_slowpath_diag(uint64_t TypeId, void *Ptr, void *DiagData)
+{
+    switch (g_engine)
+    {
+    case XVCFI_ENGINE_ORIG:
+        ENGINE_STAT_INC(XVCFI_ENGINE_ORIG, calls);
+        ENGINE_STAT_INC(XVCFI_ENGINE_ORIG, misses);
+        cfi_slowpath_diag_orig(TypeId, Ptr, DiagData);
+        break;
+    default:
+        ENGINE_STAT_INC(XVCFI_ENGINE_SWISS, calls);
+        swiss_slowpath_diag(TypeId, Ptr, DiagData);
+        break;
+    }
+}
+
+// Copy the counters of the active engine into *stats, for benchmarks that
+// report them per phase. They stay zero unless CFI_OPTIONS has
+// xvcfi_print_stats=1.
+extern "C" SANITIZER_INTERFACE_ATTRIBUTE void __xvcfiopt_get_stats(xvcfi_engine_stats_t *stats)
+{
+    xvcfi_engine_stats_t *engine_stats = &g_engine_stats[g_engine];
+    stats->calls = __atomic_load_n(&engine_stats->calls, __ATOMIC_RELAXED);
+    stats->hits = __atomic_load_n(&engine_stats->hits, __ATOMIC_RELAXED);
+    stats->misses = __atomic_load_n(&engine_stats->misses, __ATOMIC_RELAXED);
+    stats->bypasses = __atomic_load_n(&engine_stats->bypasses, __ATOMIC_RELAXED);
+    stats->migrations = __atomic_load_n(&engine_stats->migrations, __ATOMIC_RELAXED);
 }
@@ -0,0 +1,136 @@
+#!/usr/bin/env python3
+# -*- coding: utf-8 -*-
+
+"""
+Generates a prewarmed verify_cache image (xvcfiopt_image.h) from the profiles
+that CFI_OPTIONS=xvcfi_dump_profile=<path> writes at exit, one per process.
+The output is a C file defining __xvcfiopt_image; compile it and link it into
+the executable, e.g. with -fsanitize-xvcfiopt-image=<object file> when
+linking with -fsanitize=cfi-vcall -fsanitize-cfi-cross-dso. The runtime then
+starts with the profiled signatures in its verify_cache.
+
+Profiles of several runs and processes are merged. A signature is kept if it
+occurs in at least --min-runs of the profiles.
+
+Example:
+  CFI_OPTIONS=xvcfi_dump_profile=/tmp/app.prof ./app
+  python3 gen_verify_image.py /tmp/app.prof.* -o app_image.c
+  clang -c app_image.c -o app_image.o
+  clang++ -fsanitize=cfi-vcall -fsanitize-xvcfiopt-image=app_image.o ... -o app
+"""
+
+import argparse
+import collections
+import sys
+
+IMAGE_MAGIC = 0x78766369  # XVCFI_IMAGE_MAGIC
+IMAGE_VERSION = 1  # XVCFI_IMAGE_VERSION
+
+HEADER = """\
+// Generated by gen_verify_image.py from {profiles} profile(s): {signatures}
+// signatures of {modules} module(s). Do not edit.
+#include <stdint.h>
+
+// The layout of xvcfiopt_image.h, version {version}.
+typedef struct {{
+  uint64_t type_id;
+  uint32_t offset;
+  uint32_t pad;
+}} xvcfi_image_entry_t;
+
+typedef struct {{
+  const char *name;
+  uint32_t first;
+  uint32_t count;
+}} xvcfi_image_module_t;
+
+typedef struct {{
+  uint32_t magic;
+  uint32_t version;
+  uint32_t n_modules;
+  uint32_t n_entries;
+  const xvcfi_image_module_t *modules;
+  const xvcfi_image_entry_t *entries;
+}} xvcfi_image_t;
+"""
+
+
+def parse_profile(path):
+    """Return the set of (module, type_id, offset) signatures of a profile."""
+    signatures = set()
+    with open(path, encoding="utf-8", errors="surrogateescape") as f:
+        for lineno, line in enumerate(f, 1):
+            fields = line.rstrip("\n").split(" ", 2)
+            if len(fields) < 2:
+                sys.exit(f"{path}:{lineno}: expected '<type id> <offset> <module>'")
+            try:
+                type_id, offset = int(fields[0], 16), int(fields[1], 16)
+            except ValueError:
+                sys.exit(f"{path}:{lineno}: malformed signature '{line.rstrip()}'")
+            module = fields[2] if len(fields) == 3 else ""
+            signatures.add((module, type_id, offset))
+    return signatures
+
+
+def c_string(s):
+    out = []
+    for ch in s.encode("utf-8", errors="surrogateescape"):
+        if ch in (0x22, 0x5C):
+            out.append("\\" + chr(ch))
+        elif 0x20 <= ch < 0x7F:
+            out.append(chr(ch))
+        else:
+            out.append(f"\\{ch:03o}")
+    return '"' + "".join(out) + '"'
+
+
+def generate(profiles, min_runs):
+    counts = collections.Counter()
+    for path in profiles:
+        counts.update(parse_profile(path))
+
+    by_module = collections.defaultdict(list)
+    for (module, type_id, offset), n in counts.items():
+        if n >= min_runs:
+            by_module[module].append((type_id, offset))
+
+    n_entries = sum(len(v) for v in by_module.values())
+    lines = [HEADER.format(profiles=len(profiles), signatures=n_entries,
+                           modules=len(by_module), version=IMAGE_VERSION)]
+
+    modules, entries = [], []
+    for module in sorted(by_module):
+        signatures = sorted(by_module[module])
+        modules.append(f"  {{{c_string(module)}, {len(entries)}, {len(signatures)}}},")
+        entries.extend(f"  {{0x{t:x}ull, 0x{o:x}, 0}}," for t, o in signatures)
+
+    # Arrays of at least one element keep the file valid C for empty profiles.
+    lines.append("static const xvcfi_image_module_t modules[] = {")
+    lines.extend(modules or ['  {"", 0, 0},'])
+    lines.append("};\n")
+    lines.append("static const xvcfi_image_entry_t entries[] = {")
+    lines.extend(entries or ["  {0, 0, 0},"])
+    lines.append("};\n")
+    # Default visibility, for the shared runtime (-shared-libsan) to find it.
+    lines.append("__attribute__((visibility(\"default\"))) const xvcfi_image_t __xvcfiopt_image = {")
+    lines.append(f"  0x{IMAGE_MAGIC:x}u, {IMAGE_VERSION}, {len(modules)}, {n_entries}, modules, entries,")
+    lines.append("};")
+    return "\n".join(lines) + "\n", n_entries, len(modules)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("profiles", nargs="+", help="profiles written with xvcfi_dump_profile")
+    parser.add_argument("-o", "--output", required=True, help="C file to write")
+    parser.add_argument("--min-runs", type=int, default=1,
+                        help="profiles a signature must occur in (default: 1)")
+    args = parser.parse_args()
+
+    source, n_entries, n_modules = generate(args.profiles, args.min_runs)
+    with open(args.output, "w", encoding="utf-8") as f:
+        f.write(source)
+    print(f"{args.output}: {n_entries} signatures of {n_modules} modules")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,151 @@
+// perfect_hash.h
+//
+// Read-only minimal perfect hash table of vcall signatures, built once from a
+// set of keys (hash and displace). A first hash splits the keys into buckets
+// of about PH_BUCKET_KEYS keys. Every bucket gets the seed of a second hash
+// that sends each of its keys to its own slot, so n keys fill exactly n slots.
+// A lookup reads the seed of its bucket and compares the one slot it points
+// to: no probing, whatever the keys.
+//
+// The table does no allocation. The caller provides bytes_for(n) bytes for
+// the table and scratch_bytes(n) bytes for its construction, zero-filled.
+#ifndef XVCFIOPT_PERFECT_HASH_H
+#define XVCFIOPT_PERFECT_HASH_H
+
+#include "swiss_table.h"
+
+#define PH_BUCKET_KEYS 4      // Average keys per bucket
+#define PH_MAX_SEED (1 << 20) // Seeds tried per bucket before giving up
+
+namespace __xvcfiopt
+{
+
+// Map the upper half of h onto [0, n).
+static inline __attribute__((always_inline)) uint32_t ph_reduce(uint64_t h, uint32_t n)
+{
+    return (uint32_t)(((h >> 32) * n) >> 32);
+}
+
+// Slot hash of a key hash under a bucket seed (murmur3 finalizer).
+static inline __attribute__((always_inline)) uint64_t ph_slot_hash(uint64_t h, uint32_t seed)
+{
+    h ^= seed * 0x9e3779b97f4a7c15ul;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdul;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ul;
+    return h ^ (h >> 33);
+}
+
+struct ph_table
+{
+    uint32_t n_keys;  // Also the number of slots
+    uint32_t n_buckets;
+    size_t bytes;     // bytes_for(n_keys), for the caller to release the table
+    uint32_t *seeds;  // n_buckets seeds, after the header
+    hm_keyv_t *slots; // n_keys entries, after the seeds
+
+    static uint32_t buckets_for(uint32_t n) { return n / PH_BUCKET_KEYS + 1; }
+
+    static size_t bytes_for(uint32_t n)
+    {
+        size_t seeds_end = sizeof(ph_table) + buckets_for(n) * sizeof(uint32_t);
+        return (seeds_end + 15) / 16 * 16 + n * sizeof(hm_keyv_t);
+    }
+
+    // Bucket offsets, key order, bucket order, used slots and the slots of one bucket.
+    static size_t scratch_bytes(uint32_t n)
+    {
+        return (buckets_for(n) + 1 + n + buckets_for(n) + n) * sizeof(uint32_t) + n;
+    }
+
+    __attribute__((always_inline)) hm_keyv_t *find(hm_keyv_t keyv) const
+    {
+        uint64_t h = hash_kvpair(keyv);
+        uint32_t seed = seeds[ph_reduce(h, n_buckets)];
+        hm_keyv_t *slot = &slots[ph_reduce(ph_slot_hash(h, seed), n_keys)];
+        return kvpair_equals(*slot, keyv) ? slot : NULL;
+    }
+
+    // Lay out the table for the n distinct keys and find the seeds. Returns
+    // false if some bucket found no seed, e.g. for keys of identical hashes,
+    // and for no keys at all: an empty table has no slot to compare.
+    bool build(const hm_keyv_t *keys, uint32_t n, void *scratch)
+    {
+        n_keys = n;
+        n_buckets = buckets_for(n);
+        bytes = bytes_for(n);
+        seeds = (uint32_t *)(this + 1);
+        slots = (hm_keyv_t *)((char *)this + (bytes - n * sizeof(hm_keyv_t)));
+        if (n == 0)
+            return false;
+
+        uint32_t *bucket_start = (uint32_t *)scratch; // n_buckets + 1 offsets into key_order
+        uint32_t *key_order = bucket_start + n_buckets + 1; // Keys grouped by bucket
+        uint32_t *bucket_order = key_order + n;             // Buckets, largest first
+        uint32_t *bucket_slots = bucket_order + n_buckets;  // Slots taken by the bucket at hand
+        uint8_t *used = (uint8_t *)(bucket_slots + n);
+
+        // Group the keys by bucket: counts, offsets, then placement.
+        for (uint32_t i = 0; i < n; i++)
+            bucket_start[ph_reduce(hash_kvpair(keys[i]), n_buckets) + 1]++;
+        uint32_t max_size = 0;
+        for (uint32_t b = 0; b < n_buckets; b++)
+        {
+            max_size = bucket_start[b + 1] > max_size ? bucket_start[b + 1] : max_size;
+            bucket_start[b + 1] += bucket_start[b];
+        }
+        for (uint32_t i = 0; i < n; i++)
+        {
+            uint32_t b = ph_reduce(hash_kvpair(keys[i]), n_buckets);
+            key_order[bucket_start[b] + seeds[b]++] = i; // seeds count placed keys for now
+        }
+
+        // Seat the largest buckets first, while most slots are free.
+        uint32_t n_order = 0;
+        for (uint32_t size = max_size; size > 0; size--)
+        {
+            for (uint32_t b = 0; b < n_buckets; b++)
+            {
+                if (bucket_start[b + 1] - bucket_start[b] == size)
+                    bucket_order[n_order++] = b;
+            }
+        }
+
+        for (uint32_t b = 0; b < n_buckets; b++)
+            seeds[b] = 0;
+        for (uint32_t k = 0; k < n_order; k++)
+        {
+            uint32_t b = bucket_order[k];
+            uint32_t first = bucket_start[b], size = bucket_start[b + 1] - first;
+            uint32_t seed;
+            for (seed = 0; seed < PH_MAX_SEED; seed++)
+            {
+                uint32_t taken = 0;
+                for (; taken < size; taken++)
+                {
+                    uint32_t slot = ph_reduce(ph_slot_hash(hash_kvpair(keys[key_order[first + taken]]), seed), n);
+                    if (used[slot])
+                        break;
+                    used[slot] = 1;
+                    bucket_slots[taken] = slot;
+                }
+                if (taken == size)
+                    break;
+                while (taken > 0)
+                    used[bucket_slots[--taken]] = 0; // Undo the partial placement
+            }
+            if (seed == PH_MAX_SEED)
+                return false;
+
+            seeds[b] = seed;
+            for (uint32_t i = 0; i < size; i++)
+                slots[bucket_slots[i]] = keys[key_order[first + i]];
+        }
+        return true;
+    }
+};
+
+} // namespace __xvcfiopt
+
+#endif // XVCFIOPT_PERFECT_HASH_H
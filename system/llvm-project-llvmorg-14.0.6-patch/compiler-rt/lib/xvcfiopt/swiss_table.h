@@ -0,0 +1,681 @@
+// swiss_table.h
+//
+// Header-only swiss table for cross-DSO vcall signatures. It is shared by the
+// xvcfiopt runtime (cfi_xdso_cache.cpp) and the prototypes in
+// system/prototype-verifier and system/prototype-standalone.
+//
+// A table is an hm_table<Width, Usage, Capacity>:
+//  - Width is the number of slots per group: 16 (one SSE2 compare per group)
+//    or 8 (SWAR on a 64-bit word, portable).
+//  - Usage selects the verify or the record behaviour at compile time.
+//  - Capacity is hm_fixed_capacity<N> or hm_runtime_capacity. Either way the
+//    number of groups is a power of two, so probing only masks.
+//
+// Control bytes use zero for empty slots. Zero-filled memory (.bss, a fresh
+// mmap) therefore is a valid empty table without any initializer.
+// The table itself does no locking. Mutations must not run concurrently with
+// each other. Readers racing a mutation never read outside the table, but may
+// see an entry halfway through a write or a move, e.g. the class_id of one
+// signature and the vptr of another. A concurrent reader must therefore take
+// a read_begin() count before its lookup and only trust what it found if
+// read_valid() still holds afterwards.
+#ifndef XVCFIOPT_SWISS_TABLE_H
+#define XVCFIOPT_SWISS_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#ifndef HM_LOAD_FACTOR
+#define HM_LOAD_FACTOR (0.75)
+#endif
+
+#ifndef HM_COMPACT_FACTOR
+#define HM_COMPACT_FACTOR (0.10) // Compact a table once this fraction of its slots are tombstones
+#endif
+
+#if defined(__SSE2__)
+#define HM_GROUP_SIZE (16)
+#else
+#define HM_GROUP_SIZE (8)
+#endif
+
+#define MAP_EVICT_MIN_COUNT 10   // Number of entries the eviction hand frees per reduction
+#define MAP_EVICT_STEP 2         // Groups the eviction hand may inspect per reduction
+#define MAP_MIGRATE_MIN_FREQ 4   // Minimum value to migrate from record_map
+#define CACHE_MISS_THRESHOLD 100 // Trigger migration when this many entries are recorded
+
+namespace __xvcfiopt
+{
+
+typedef struct
+{
+    size_t class_id; // a type identifier generated by the clang/llvm;
+    int vptr;        // Using int to store pointer values for better memory efficiency;
+    int data;        // extra information
+} hm_keyv_t;
+
+typedef size_t hm_data_t;
+
+typedef enum // Usage types for this hashmap
+{
+    HM_TYPE_VERIFY = 0, // Only key-value pairs
+    HM_TYPE_RECORD = 1, // with additional data
+} hm_usage_t;
+
+typedef enum : uint8_t
+{
+    HM_EMPTY = 0x00,   // Never used since the last clear or compaction
+    HM_DELETED = 0x7f, // Tombstone left by eviction
+    HM_FULL = 0x80,    // Live entry, the low 7 bits hold hash metadata
+} hm_ctrl_e;
+
+typedef struct
+{
+    uint8_t ctrl; // HM_FULL | 7 bits of the hash
+    uint32_t pos; // Home slot, before masking
+} hm_hash_t;
+
+// The policy knobs of the tables and of the migration built on them. The
+// defaults are the compile-time macros above; the runtime can override them
+// through CFI_OPTIONS (see xvcfiopt_flags.inc).
+typedef struct
+{
+    int load_factor_pct;  // Reduce a table once items >= size * load_factor_pct / 100, or size - 1
+    int compact_pct;      // Compact a table once deleted >= size * compact_pct / 100
+    int evict_min_count;  // MAP_EVICT_MIN_COUNT
+    int evict_step;       // MAP_EVICT_STEP
+    int migrate_min_freq; // MAP_MIGRATE_MIN_FREQ
+    int miss_threshold;   // CACHE_MISS_THRESHOLD
+} hm_tuning_t;
+
+static constexpr hm_tuning_t hm_default_tuning = {
+    .load_factor_pct = (int)(HM_LOAD_FACTOR * 100),
+    .compact_pct = (int)(HM_COMPACT_FACTOR * 100),
+    .evict_min_count = MAP_EVICT_MIN_COUNT,
+    .evict_step = MAP_EVICT_STEP,
+    .migrate_min_freq = MAP_MIGRATE_MIN_FREQ,
+    .miss_threshold = CACHE_MISS_THRESHOLD,
+};
+
+static inline __attribute__((always_inline)) size_t hash_kvpair(hm_keyv_t vcall_sign)
+{
+    // Multiply-shift mixing. hm_hash_t::pos takes the upper bits and vptr only
+    // has 32 bits, so spread vptr over the whole word before it meets class_id;
+    // otherwise all vtables of one type share a probe sequence. The fold moves
+    // the well-mixed upper half of the product into the metadata bits.
+    uint64_t vptr = (uint32_t)vcall_sign.vptr;
+    uint64_t h = (vcall_sign.class_id ^ (vptr << 32 | vptr)) * 0x9e3779b97f4a7c15ul;
+    return h ^ (h >> 32);
+}
+
+static inline __attribute__((always_inline)) bool kvpair_equals(hm_keyv_t kv1, hm_keyv_t kv2)
+{
+    return (kv1.class_id == kv2.class_id) && (kv1.vptr == kv2.vptr);
+}
+
+//------------------------Begin: Group control words--------------------------------------
+// hm_group_ctrl<Width> matches the control bytes of one group at once. Every
+// match returns a mask with bit i set for slot i.
+template <int Width>
+struct hm_group_ctrl;
+
+#if defined(__SSE2__)
+template <>
+struct hm_group_ctrl<16>
+{
+    typedef __m128i word_t;
+    typedef uint16_t mask_t;
+
+    static __attribute__((always_inline)) mask_t match(word_t ctrl, uint8_t byte)
+    {
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(byte)));
+    }
+
+    static __attribute__((always_inline)) mask_t match_full(word_t ctrl)
+    {
+        return _mm_movemask_epi8(ctrl);
+    }
+
+    // Full slots become HM_DELETED, all others HM_EMPTY.
+    static __attribute__((always_inline)) word_t mark_full_deleted(word_t ctrl)
+    {
+        return _mm_and_si128(_mm_cmplt_epi8(ctrl, _mm_setzero_si128()), _mm_set1_epi8(HM_DELETED));
+    }
+};
+#endif
+
+template <>
+struct hm_group_ctrl<8>
+{
+    typedef uint64_t word_t;
+    typedef uint8_t mask_t;
+
+    static const uint64_t lsbs = 0x0101010101010101ul;
+    static const uint64_t msbs = 0x8080808080808080ul;
+
+    // Move the top bit of byte i to bit i.
+    static __attribute__((always_inline)) mask_t gather(uint64_t bits)
+    {
+        return (mask_t)(((bits & msbs) * 0x0002040810204081ul) >> 56);
+    }
+
+    static __attribute__((always_inline)) mask_t match(word_t ctrl, uint8_t byte)
+    {
+        // Exact zero-byte test; no carry crosses a byte boundary.
+        uint64_t x = ctrl ^ (lsbs * byte);
+        return gather(~(((x & ~msbs) + ~msbs) | x | ~msbs));
+    }
+
+    static __attribute__((always_inline)) mask_t match_full(word_t ctrl)
+    {
+        return gather(ctrl);
+    }
+
+    static __attribute__((always_inline)) word_t mark_full_deleted(word_t ctrl)
+    {
+        return ((ctrl & msbs) >> 7) * HM_DELETED;
+    }
+};
+
+template <int Width>
+struct hm_group_t
+{
+    typename hm_group_ctrl<Width>::word_t ctrl;
+    hm_keyv_t keyv[Width];
+    hm_hash_t hash[Width];
+};
+//-------------------------End: Group control words---------------------------------------
+
+//------------------------Begin: Capacity policies----------------------------------------
+// The number of groups is fixed at compile time, so the masks fold into the
+// probe code.
+template <int NGroups>
+struct hm_fixed_capacity
+{
+    static_assert(NGroups > 0 && (NGroups & (NGroups - 1)) == 0, "the number of groups must be a power of two");
+
+    int n_groups() const { return NGroups; }
+};
+
+// The number of groups is chosen when the table is set up, e.g. from
+// CFI_OPTIONS. It must be a power of two.
+struct hm_runtime_capacity
+{
+    int groups_mask; // n_groups - 1
+
+    int n_groups() const { return groups_mask + 1; }
+};
+//-------------------------End: Capacity policies-----------------------------------------
+
+// A swiss-table with a fixed number of groups. The groups follow the header
+// in memory, see hm_table_storage.
+template <int Width, hm_usage_t Usage, class Capacity>
+struct hm_table
+{
+    typedef hm_group_ctrl<Width> ctrl_t;
+    typedef typename ctrl_t::mask_t mask_t;
+    typedef typename ctrl_t::word_t word_t;
+    typedef hm_group_t<Width> group_t;
+
+    static_assert(Width > 0 && (Width & (Width - 1)) == 0, "the group width must be a power of two");
+
+    Capacity capacity;
+    const hm_tuning_t *tuning; // NULL means hm_default_tuning
+    int items;
+    int deleted;      // Number of slots marked HM_DELETED
+    int sentinel;     // The highest slot used since the last clear or compaction
+    int generation;   // HM_TYPE_VERIFY: number of transfers, the default tag
+    int clock_hand;   // The last group inspected by the eviction hand
+    mask_t *ref_bits; // HM_TYPE_VERIFY: per-group referenced bits, kept outside
+                      // the table so that hits can set them while it is read-only
+    volatile unsigned seq; // Odd while a mutation is in progress
+    int write_depth;       // Nesting of write_begin()
+    group_t groups[0] __attribute__((aligned(32)));
+
+    int n_groups() const { return capacity.n_groups(); }
+    int size() const { return n_groups() * Width; }
+    const hm_tuning_t &tune() const { return tuning ? *tuning : hm_default_tuning; }
+
+    static __attribute__((always_inline)) hm_hash_t hash_of(hm_keyv_t keyv)
+    {
+        size_t h = hash_kvpair(keyv);
+        hm_hash_t hash = {(uint8_t)(HM_FULL | (h & 0x7f)), (uint32_t)(h >> 32)};
+        return hash;
+    }
+
+    uint8_t *ctrl_bytes(int group) { return (uint8_t *)&groups[group].ctrl; }
+
+    //----------------------Begin: Sequence count-----------------------------------------
+    // Every mutation runs between write_begin() and write_end(). They nest, so
+    // that a caller can make a whole migration a single write for the readers.
+    void write_begin()
+    {
+        if (write_depth++ > 0)
+            return;
+        __atomic_store_n(&seq, seq + 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_RELEASE);
+    }
+
+    void write_end()
+    {
+        if (--write_depth > 0)
+            return;
+        __atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+    }
+
+    // Forget a write that will never end, e.g. the one of a process that died
+    // while writing a shared table. Its entries must be cleared afterwards.
+    void write_abandon()
+    {
+        write_depth = 0;
+        if (seq & 1)
+            __atomic_store_n(&seq, seq + 1, __ATOMIC_RELEASE);
+    }
+
+    // The count to pass to read_valid(). Odd means a write is in progress.
+    __attribute__((always_inline)) unsigned read_begin() const
+    {
+        return __atomic_load_n(&seq, __ATOMIC_ACQUIRE);
+    }
+
+    // True if nothing was written since read_begin() returned seq.
+    __attribute__((always_inline)) bool read_valid(unsigned seq_begin) const
+    {
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        return !(seq_begin & 1) && __atomic_load_n(&seq, __ATOMIC_RELAXED) == seq_begin;
+    }
+    //-----------------------End: Sequence count------------------------------------------
+
+    // Return the element pointer of the key-value pair in the hashmap.
+    // If the key is not found, return NULL.
+    __attribute__((always_inline)) hm_keyv_t *find(hm_keyv_t keyv)
+    {
+        return find_hashed(hash_of(keyv), keyv);
+    }
+
+    __attribute__((always_inline)) hm_keyv_t *find_hashed(hm_hash_t hash, hm_keyv_t keyv)
+    {
+        int idx = hash.pos & (size() - 1);
+        int group = idx / Width;
+        mask_t from = (mask_t)(~0u << (idx % Width)); // The home group is probed from idx on
+
+        while (true)
+        {
+            word_t ctrl = groups[group].ctrl;
+            for (mask_t matches = ctrl_t::match(ctrl, hash.ctrl) & from; matches; matches &= matches - 1)
+            {
+                int group_pos = __builtin_ctz(matches);
+                if (kvpair_equals(groups[group].keyv[group_pos], keyv))
+                    return &groups[group].keyv[group_pos];
+            }
+            if (ctrl_t::match(ctrl, HM_EMPTY) & from)
+                return NULL;
+
+            group = (group + 1) & (n_groups() - 1);
+            from = (mask_t)~0u;
+        }
+    }
+
+    // Mark an entry returned by find() as referenced, so that the eviction hand
+    // gives it a second chance. Only verify tables keep referenced bits.
+    __attribute__((always_inline)) void touch(hm_keyv_t *key_ref)
+    {
+        if (Usage != HM_TYPE_VERIFY || ref_bits == NULL)
+            return;
+
+        int group = ((char *)key_ref - (char *)groups) / sizeof(group_t);
+        mask_t bit = (mask_t)(1u << (key_ref - groups[group].keyv));
+        // Hot entries are already marked, so most hits do not write the shared bits.
+        if (!(ref_bits[group] & bit))
+            __atomic_fetch_or(&ref_bits[group], bit, __ATOMIC_RELAXED);
+    }
+
+    // map[hash(keyv)] = keyv;
+    // The entry keeps value as its data: the count of a record entry, the tag
+    // of a verify entry.
+    void insert(hm_keyv_t keyv, hm_data_t value)
+    {
+        write_begin();
+        if (should_reduce())
+            reduce();
+        if (should_compact())
+            compact();
+
+        keyv.data = (int)value;
+        int slot = insert_hashed(hash_of(keyv), keyv);
+
+        // New entries start referenced, so they survive the first pass of the hand.
+        if (ref_bits)
+            __atomic_fetch_or(&ref_bits[slot / Width], (mask_t)(1u << (slot % Width)), __ATOMIC_RELAXED);
+        write_end();
+    }
+
+    void clear()
+    {
+        write_begin();
+        int end_group = sentinel / Width + 1;
+        for (int group = 0; group < end_group; group++)
+        {
+            groups[group].ctrl = word_t();
+            if (ref_bits)
+                ref_bits[group] = 0;
+        }
+        items = 0;
+        deleted = 0;
+        sentinel = 0;
+        clock_hand = 0;
+        write_end();
+    }
+
+    // Iterate through the hashmap, idx is the current index in the hashmap.
+    // *key_ref is the entry at idx, or NULL for a free slot.
+    bool iterate(int *idx, hm_keyv_t **key_ref)
+    {
+        if (*idx > sentinel)
+            return false;
+
+        int group = *idx / Width, group_pos = *idx % Width;
+        *key_ref = (ctrl_bytes(group)[group_pos] & HM_FULL) ? &groups[group].keyv[group_pos] : NULL;
+
+        (*idx)++;
+        return true;
+    }
+
+    // HM_TYPE_RECORD: count one more miss of keyv and return its count.
+    int track(hm_keyv_t keyv)
+    {
+        static_assert(Usage == HM_TYPE_RECORD, "only record tables count signatures");
+        hm_keyv_t *key_ref = find(keyv);
+        if (!key_ref)
+        {
+            insert(keyv, 1);
+            return 1;
+        }
+        write_begin();
+        int count = ++key_ref->data;
+        write_end();
+        return count;
+    }
+
+    // HM_TYPE_VERIFY: start a new generation with the entries of record seen
+    // more than freq times. tag(keyv, &data) gives the data of a migrated
+    // entry, or returns false to leave the signature out. A signature that is
+    // already in the table only takes the new data, so that a stale entry
+    // cannot shadow its replacement.
+    template <class RecordTable, class Tagger>
+    void transfer_from(RecordTable *record, int freq, Tagger tag)
+    {
+        static_assert(Usage == HM_TYPE_VERIFY, "only verify tables take migrated signatures");
+        int idx = 0;
+        hm_keyv_t *key_ref;
+
+        write_begin();
+        generation++;
+        while (record->iterate(&idx, &key_ref))
+        {
+            if (key_ref == NULL)
+                continue; // Skip empty slots
+            if (key_ref->data <= freq)
+                continue; // Skip cold signatures
+            int data;
+            if (!tag(*key_ref, &data))
+                continue; // Skip signatures the caller cannot vouch for
+            hm_keyv_t *existing = find(*key_ref);
+            if (existing)
+            {
+                existing->data = data;
+                touch(existing);
+            }
+            else
+                insert(*key_ref, data);
+        }
+        write_end();
+    }
+
+    // Same, tagging the migrated entries with the new generation.
+    template <class RecordTable>
+    void transfer_from(RecordTable *record, int freq)
+    {
+        transfer_from(record, freq, [this](hm_keyv_t, int *data) {
+            *data = generation;
+            return true;
+        });
+    }
+
+    //----------------------Begin: Reduction and compaction-------------------------------
+    // The load factor may round up to every slot, e.g. 95% of a single group;
+    // one slot always stays free, as lookups only stop at an empty slot.
+    bool should_reduce() const
+    {
+        return items * 100 >= tune().load_factor_pct * size() || items >= size() - 1;
+    }
+
+    // Compact once tombstones cross the threshold, or once less than a group
+    // of empty slots is left: lookups only stop at an empty slot. Without
+    // tombstones there is nothing to gain, e.g. in a table of a single group.
+    bool should_compact() const
+    {
+        return deleted > 0 && (deleted * 100 >= tune().compact_pct * size() || size() - items - deleted <= Width);
+    }
+
+    // The eviction hand may run past its step budget until it freed a slot of
+    // a table at its load limit, e.g. one whose entries are all referenced, and
+    // until the table is no longer about to run out of free slots.
+    bool must_evict(int num_evicted) const
+    {
+        return items > 0 && ((num_evicted == 0 && should_reduce()) || items >= size() - Width);
+    }
+
+    void evict_at(int group, int group_pos)
+    {
+        ctrl_bytes(group)[group_pos] = HM_DELETED;
+        items--;
+        deleted++;
+    }
+
+    void reduce()
+    {
+        write_begin();
+        if (Usage == HM_TYPE_VERIFY)
+            reduce_verify();
+        else
+            reduce_record();
+
+        if (items == 0)
+            clear();
+        write_end();
+    }
+
+    // Use the CLOCK (second-chance) policy to evict entries from the verify
+    // table. Each reduction advances the hand by at most tuning.evict_step
+    // groups, or as far as it takes to free one entry, and frees up to
+    // tuning.evict_min_count entries. Referenced entries
+    // lose their bit and survive until the hand comes around again, so hot
+    // signatures stay regardless of the migration that inserted them.
+    void reduce_verify()
+    {
+        const hm_tuning_t &t = tune();
+        int group = clock_hand;
+        int end_group = sentinel / Width + 1;
+        int budget = t.evict_step;
+        int num_evicted = 0;
+
+        while (num_evicted < t.evict_min_count && (budget-- > 0 || must_evict(num_evicted)))
+        {
+            group = (group + 1 < end_group) ? group + 1 : 0;
+
+            mask_t match_full = ctrl_t::match_full(groups[group].ctrl);
+            mask_t referenced = ref_bits ? (ref_bits[group] & match_full) : 0;
+            mask_t victims = match_full & ~referenced;
+
+            if (referenced)
+                __atomic_fetch_and(&ref_bits[group], (mask_t)~referenced, __ATOMIC_RELAXED);
+
+            for (; victims && num_evicted < t.evict_min_count; victims &= victims - 1)
+            {
+                evict_at(group, __builtin_ctz(victims));
+                num_evicted++;
+            }
+        }
+        clock_hand = group;
+    }
+
+    // Use the frequency policy to evict entries from the record table. The
+    // hand advances by at most tuning.evict_step groups per reduction and frees
+    // entries seen at most migrate_min_freq + 1 times. Only when it freed
+    // nothing or the table is about to fill up does it keep going, doubling the
+    // bar on every revolution.
+    void reduce_record()
+    {
+        const hm_tuning_t &t = tune();
+        int group = clock_hand;
+        int end_group = sentinel / Width + 1;
+        int budget = t.evict_step;
+        int num_evicted = 0; // Number of entries evicted during the reduction
+        int scanned = 0;     // Groups inspected at the current min_freq
+
+        int min_freq = t.migrate_min_freq + 1;
+        while (num_evicted < t.evict_min_count && (budget-- > 0 || must_evict(num_evicted)))
+        {
+            group = (group + 1 < end_group) ? group + 1 : 0;
+
+            for (mask_t match_full = ctrl_t::match_full(groups[group].ctrl);
+                 match_full && num_evicted < t.evict_min_count; match_full &= match_full - 1)
+            {
+                int group_pos = __builtin_ctz(match_full);
+                if (groups[group].keyv[group_pos].data <= min_freq)
+                {
+                    evict_at(group, group_pos);
+                    num_evicted++;
+                }
+            }
+
+            if (++scanned == end_group)
+            {
+                scanned = 0;
+                min_freq *= 2;
+            }
+        }
+        clock_hand = group;
+    }
+
+    // Rehash the table in place and drop all tombstones, so that probe
+    // sequences are as short as in a freshly filled table again. Every live
+    // entry moves to the first free slot of its probe sequence. Entries that
+    // are not placed yet are marked HM_DELETED; a slot taken from such an
+    // entry is swapped with it. Entries are torn while they move, see read_valid().
+    void compact()
+    {
+        write_begin();
+        int end_group = n_groups();
+
+        // Tombstones become empty, live entries become "not placed yet".
+        for (int group = 0; group < end_group; group++)
+            groups[group].ctrl = ctrl_t::mark_full_deleted(groups[group].ctrl);
+        deleted = 0;
+        sentinel = 0;
+
+        for (int idx = 0; idx < size(); idx++)
+        {
+            uint8_t *ctrl = ctrl_bytes(idx / Width);
+
+            while (ctrl[idx % Width] == HM_DELETED)
+            {
+                hm_hash_t hash = groups[idx / Width].hash[idx % Width];
+                int slot = find_slot(hash);
+                uint8_t *slot_ctrl = ctrl_bytes(slot / Width);
+
+                if (slot != idx)
+                {
+                    swap_slots(idx, slot);
+                    // A swapped-in entry still has to be placed, an empty slot is done.
+                    if (slot_ctrl[slot % Width] == HM_EMPTY)
+                        ctrl[idx % Width] = HM_EMPTY;
+                }
+                slot_ctrl[slot % Width] = hash.ctrl;
+
+                if (slot > sentinel)
+                    sentinel = slot;
+            }
+        }
+        write_end();
+    }
+    //-----------------------End: Reduction and compaction--------------------------------
+
+    // Return the index of the first free (empty or deleted) slot on the probe
+    // sequence of hash.
+    int find_slot(hm_hash_t hash)
+    {
+        int idx = hash.pos & (size() - 1);
+        int group = idx / Width;
+        mask_t from = (mask_t)(~0u << (idx % Width));
+
+        while (true)
+        {
+            mask_t free_slots = (mask_t)~ctrl_t::match_full(groups[group].ctrl) & from;
+            if (free_slots)
+                return group * Width + __builtin_ctz(free_slots);
+
+            group = (group + 1) & (n_groups() - 1);
+            from = (mask_t)~0u;
+        }
+    }
+
+    // Store keyv and return the index of its slot.
+    int insert_hashed(hm_hash_t hash, hm_keyv_t keyv)
+    {
+        int slot = find_slot(hash);
+        int group = slot / Width, group_pos = slot % Width;
+
+        if (ctrl_bytes(group)[group_pos] == HM_DELETED)
+            deleted--;
+
+        ctrl_bytes(group)[group_pos] = hash.ctrl;
+        groups[group].keyv[group_pos] = keyv;
+        groups[group].hash[group_pos] = hash;
+
+        items++;
+
+        if (slot > sentinel)
+            sentinel = slot;
+        return slot;
+    }
+
+    // Exchange the contents of two slots, except for their control bytes.
+    void swap_slots(int idx1, int idx2)
+    {
+        group_t *g1 = &groups[idx1 / Width], *g2 = &groups[idx2 / Width];
+        int p1 = idx1 % Width, p2 = idx2 % Width;
+
+        hm_keyv_t keyv = g1->keyv[p1];
+        g1->keyv[p1] = g2->keyv[p2];
+        g2->keyv[p2] = keyv;
+
+        hm_hash_t hash = g1->hash[p1];
+        g1->hash[p1] = g2->hash[p2];
+        g2->hash[p2] = hash;
+
+        if (ref_bits)
+        {
+            mask_t ref1 = (ref_bits[idx1 / Width] >> p1) & 1;
+            mask_t ref2 = (ref_bits[idx2 / Width] >> p2) & 1;
+            ref_bits[idx1 / Width] = (ref_bits[idx1 / Width] & ~(1u << p1)) | (ref2 << p1);
+            ref_bits[idx2 / Width] = (ref_bits[idx2 / Width] & ~(1u << p2)) | (ref1 << p2);
+        }
+    }
+};
+
+// A table with room for NGroups groups right behind its header.
+template <class Table, int NGroups, int Align = 32>
+struct alignas(Align) hm_table_storage
+{
+    Table table;
+    typename Table::group_t groups[NGroups];
+};
+
+} // namespace __xvcfiopt
+
+#endif // XVCFIOPT_SWISS_TABLE_H
@@ -0,0 +1,28 @@
+// xvcfiopt_flags.cpp
+#include "xvcfiopt_flags.h"
+
+#include "sanitizer_common/sanitizer_flag_parser.h"
+
+using namespace __sanitizer;
+
+namespace __xvcfiopt
+{
+
+Flags xvcfiopt_flags;
+
+void Flags::SetDefaults()
+{
+#define XVCFI_FLAG(Type, Name, DefaultValue, Description) Name = DefaultValue;
+#include "xvcfiopt_flags.inc"
+#undef XVCFI_FLAG
+}
+
+void RegisterXvcfioptFlags(FlagParser *parser, Flags *f)
+{
+#define XVCFI_FLAG(Type, Name, DefaultValue, Description) \
+    RegisterFlag(parser, #Name, Description, &f->Name);
+#include "xvcfiopt_flags.inc"
+#undef XVCFI_FLAG
+}
+
+} // namespace __xvcfiopt
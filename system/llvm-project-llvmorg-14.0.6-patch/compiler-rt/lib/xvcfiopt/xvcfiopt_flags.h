@@ -0,0 +1,30 @@
+// xvcfiopt_flags.h
+#ifndef XVCFIOPT_FLAGS_H
+#define XVCFIOPT_FLAGS_H
+
+namespace __sanitizer
+{
+class FlagParser;
+}
+
+namespace __xvcfiopt
+{
+
+struct Flags
+{
+#define XVCFI_FLAG(Type, Name, DefaultValue, Description) Type Name;
+#include "xvcfiopt_flags.inc"
+#undef XVCFI_FLAG
+
+    void SetDefaults();
+};
+
+extern Flags xvcfiopt_flags;
+inline Flags *flags() { return &xvcfiopt_flags; }
+
+// Register the xvcfiopt flags with the parser of CFI_OPTIONS.
+void RegisterXvcfioptFlags(__sanitizer::FlagParser *parser, Flags *f);
+
+} // namespace __xvcfiopt
+
+#endif // XVCFIOPT_FLAGS_H
@@ -0,0 +1,44 @@
+// xvcfiopt_image.h
+//
+// Layout of a prewarmed verify_cache image. gen_verify_image.py turns the
+// profiles dumped with CFI_OPTIONS=xvcfi_dump_profile into a C file that
+// defines __xvcfiopt_image, to be linked into the executable. Signatures are
+// stored relative to their module, which is named as dl_iterate_phdr names
+// it ("" for the executable), so that the runtime can relocate them against
+// the load address of the module whenever it is loaded.
+//
+// The generated file repeats these definitions, so that it builds without
+// the compiler-rt sources. XVCFI_IMAGE_VERSION changes with the layout.
+#ifndef XVCFIOPT_IMAGE_H
+#define XVCFIOPT_IMAGE_H
+
+#include <stdint.h>
+
+#define XVCFI_IMAGE_MAGIC 0x78766369u // "xvci"
+#define XVCFI_IMAGE_VERSION 1
+
+typedef struct
+{
+    uint64_t type_id; // CallSiteTypeId of the checks
+    uint32_t offset;  // Of the vptr from the start of the module
+    uint32_t pad;
+} xvcfi_image_entry_t;
+
+typedef struct
+{
+    const char *name; // dlpi_name of the module
+    uint32_t first;   // Its entries are entries[first, first + count)
+    uint32_t count;
+} xvcfi_image_module_t;
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_modules;
+    uint32_t n_entries;
+    const xvcfi_image_module_t *modules;
+    const xvcfi_image_entry_t *entries;
+} xvcfi_image_t;
+
+#endif // XVCFIOPT_IMAGE_H
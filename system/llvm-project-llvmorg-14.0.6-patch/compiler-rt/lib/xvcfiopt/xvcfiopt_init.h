@@ -0,0 +1,26 @@
+// xvcfiopt_init.h
+#ifndef XVCFIOPT_INIT_H
+#define XVCFIOPT_INIT_H
+
+#include <stdint.h>
+
+namespace __xvcfiopt
+{
+
+// Apply the parsed xvcfiopt flags. Called by __cfi_init after the flags of
+// CFI_OPTIONS have been parsed, and before the first cross-DSO vcall check.
+void InitAsPlugin();
+
+// Loader hooks. Every shadow update of cfi.cpp reports the loaded modules
+// between BeginModuleUpdate and EndModuleUpdate, with the shadow update lock
+// held. id tells the modules apart (their program headers), name is their
+// dlpi_name, [begin, end) spans their PT_LOAD segments. EndModuleUpdate runs
+// once the new shadow is installed, and invalidates the cached signatures of
+// unloaded modules.
+void BeginModuleUpdate();
+void AddModule(const void *id, const char *name, uintptr_t begin, uintptr_t end);
+void EndModuleUpdate();
+
+} // namespace __xvcfiopt
+
+#endif // XVCFIOPT_INIT_H
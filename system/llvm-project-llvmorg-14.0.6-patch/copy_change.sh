@@ -8,6 +8,7 @@ mkdir -p "$DEST_DIR"
 
 # 要复制的文件列表
 FILES=(
+    "clang/include/clang/Driver/Options.td.xvcfiopt"
     "clang/lib/CodeGen/CGClass.cpp"
     "clang/lib/CodeGen/CGExpr.cpp"
     "clang/lib/CodeGen/CodeGenFunction.h"
@@ -16,9 +17,15 @@ FILES=(
     "compiler-rt/lib/CMakeLists.txt"
     "compiler-rt/lib/cfi/cfi.cpp"
     "compiler-rt/lib/xvcfiopt/CMakeLists.txt"
-    "compiler-rt/lib/xvcfiopt/cache_init.inc"
     "compiler-rt/lib/xvcfiopt/cfi_xdso_cache.cpp"
-    "compiler-rt/lib/xvcfiopt/generate_cache_init.py"
+    "compiler-rt/lib/xvcfiopt/gen_verify_image.py"
+    "compiler-rt/lib/xvcfiopt/perfect_hash.h"
+    "compiler-rt/lib/xvcfiopt/swiss_table.h"
+    "compiler-rt/lib/xvcfiopt/xvcfiopt_flags.cpp"
+    "compiler-rt/lib/xvcfiopt/xvcfiopt_flags.h"
+    "compiler-rt/lib/xvcfiopt/xvcfiopt_flags.inc"
+    "compiler-rt/lib/xvcfiopt/xvcfiopt_image.h"
+    "compiler-rt/lib/xvcfiopt/xvcfiopt_init.h"
 )
 
 # 逐个复制文件
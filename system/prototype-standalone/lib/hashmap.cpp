@@ -0,0 +1,66 @@
+#include "hashmap.h"
+
+//-----------------------Begin: Define global variables-----------------------------------
+// Zero-filled tables are empty, so neither needs an initializer.
+static hm_recordcache_layout_t record_cache;
+
+// Referenced bits of verify_cache, outside of its page-aligned table.
+static hm_verify_map_t::mask_t verify_cache_ref_bits[VERIFY_GROUP_NUM];
+
+static hm_verifycache_layout_t verify_cache = {
+    .table = {.ref_bits = verify_cache_ref_bits},
+};
+//-------------------------End: Define global variables-----------------------------------
+
+//-----------------Begin: Functions for VCFI verification---------------------------------
+static void track_vcall_signature(hm_record_map_t *map_ref, hm_keyv_t keyv)
+{
+    map_ref->track(keyv);
+}
+
+#define MIGRATE_VCALL_THRESH 100 // Trigger migration when this many entries are recorded
+
+// Transfer high frequency entries from src_map to dest_map
+static bool transfer_high_freq_entries(hm_verify_map_t *verify_cache, hm_record_map_t *record_cache, int freq)
+{
+    verify_cache->transfer_from(record_cache, freq);
+    return true;
+}
+
+// Add all VCALL signatures from recording map to validating map
+static void migrate_vcall_signature(hm_verify_map_t *verify_map, hm_record_map_t *record_map)
+{
+    transfer_high_freq_entries(verify_map, record_map, MAP_MIGRATE_MIN_FREQ);
+    // Clear the record_map after migration
+    record_map->clear();
+}
+
+/**
+ * Checks if the vcall signature (type_id, vptr) exists in the verification cache.
+ * If not found, inserts it into the record cache and may trigger migration of high-frequency entries.
+ *
+ * @param type_id The type identifier for the vcall class.
+ * @param vptr The virtual pointer value for the vtable pointer.
+ */
+bool cfi_vcall_validation(size_t type_id, size_t vptr)
+{
+    // Check if the vcall_signature exists in the verify_cache
+    hm_keyv_t vcall_signature = {.class_id = type_id, .vptr = (int)vptr};
+    hm_keyv_t *kv = verify_cache.table.find(vcall_signature);
+    if (kv)
+        verify_cache.table.touch(kv);
+    else
+    {
+        static int missed_call = 0;
+        // VCALL signature not found, insert it with a count of 1
+        track_vcall_signature(&record_cache.table, vcall_signature);
+        missed_call++;
+        if (missed_call > MIGRATE_VCALL_THRESH)
+        {
+            // Migrating VCALL signatures from record_cache to verify_cache...
+            migrate_vcall_signature(&verify_cache.table, &record_cache.table);
+            missed_call = 0; // Reset the missed call counter
+        }
+    }
+    return kv != NULL; // Return true if the signature was cached
+}
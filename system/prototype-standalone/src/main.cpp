@@ -22,19 +22,19 @@ int main()
 
     for (uint64_t i = 0; i < cnt; i++)
     {
-        keys[i].type = rand_integer();
+        keys[i].class_id = rand_integer();
         keys[i].vptr = rand_integer();
         values[i] = rand_integer();
-        printf("<%lu,%lu> at idx %lu is %lu\n", keys[i].type, (uint64_t)keys[i].vptr, i, values[i]);
+        printf("<%lu,%lu> at idx %lu is %lu\n", keys[i].class_id, (uint64_t)keys[i].vptr, i, values[i]);
     }
 
     for (uint64_t j = 0; j < cnt; j++)
         for (int i = 0; i < 10; i++)
         {
-            bool res = cfi_vcall_validation(keys[i].type, keys[i].vptr);
+            bool res = cfi_vcall_validation(keys[i].class_id, keys[i].vptr);
             if (res)
-                printf("Signature <%lu,%lu> is cached\n", keys[i].type, (uint64_t)keys[i].vptr);
+                printf("Signature <%lu,%lu> is cached\n", keys[i].class_id, (uint64_t)keys[i].vptr);
             else
-                printf("Did not find <%lu,%lu> in cache\n", keys[i].type, (uint64_t)keys[i].vptr);
+                printf("Did not find <%lu,%lu> in cache\n", keys[i].class_id, (uint64_t)keys[i].vptr);
         }
 }
@@ -1,4 +1,4 @@
-#include "cfi_xdso_cache.c"
+#include "lib/hashmap.cpp"
 #include <stdio.h>
 
 // Helper function to print test results
@@ -52,12 +52,12 @@ void test_basic_vcall_validation()
     int vptr = 0xABCDEF;
 
     // First call should miss and insert into record_cache
-    __cfi_slowpath(type_id, (void *)(long)vptr);
+    cfi_vcall_validation(type_id, vptr);
 
     // Verify it's in record_cache but not verify_cache
     hm_keyv_t signature = {.class_id = type_id, .vptr = vptr};
-    bool in_record = hm_find(&record_cache.hashmap, signature) != NULL;
-    bool in_verify = hm_find(&verify_cache.hashmap, signature) != NULL;
+    bool in_record = record_cache.table.find(signature) != NULL;
+    bool in_verify = verify_cache.table.find(signature) != NULL;
 
     bool passed = in_record && !in_verify;
     print_test_result("Test basic VCALL validation (first call)", passed);
@@ -71,22 +71,22 @@ void test_basic_vcall_validation()
 void test_vcall_migration_threshold()
 {
     // Clear caches first
-    hm_clear(&record_cache.hashmap);
-    hm_clear(&verify_cache.hashmap);
+    record_cache.table.clear();
+    verify_cache.table.clear();
 
     size_t type_id = 2001;
     int vptr = 0x123456;
 
-    // Insert CACHE_MISS_THRESHOLD+1 entries to trigger migration
-    for (int i = 0; i < CACHE_MISS_THRESHOLD + 1; i++)
+    // Insert MIGRATE_VCALL_THRESH+1 entries to trigger migration
+    for (int i = 0; i < MIGRATE_VCALL_THRESH + 1; i++)
     {
-        __cfi_slowpath(type_id, (void *)(long)vptr);
+        cfi_vcall_validation(type_id, vptr);
     }
 
     // Verify signature was migrated to verify_cache
     hm_keyv_t signature = {.class_id = type_id, .vptr = vptr};
-    bool in_verify = hm_find(&verify_cache.hashmap, signature) != NULL;
-    bool record_cleared = record_cache.hashmap.items == 0;
+    bool in_verify = verify_cache.table.find(signature) != NULL;
+    bool record_cleared = record_cache.table.items == 0;
 
     bool passed = in_verify && record_cleared;
     print_test_result("Test VCALL migration threshold", passed);
@@ -100,34 +100,34 @@ void test_vcall_migration_threshold()
 void test_high_frequency_migration()
 {
     // Clear caches first
-    hm_clear(&record_cache.hashmap);
-    hm_clear(&verify_cache.hashmap);
+    record_cache.table.clear();
+    verify_cache.table.clear();
 
     size_t high_freq_type = 3001;
-    size_t high_freq_vptr = 0x111111;
+    int high_freq_vptr = 0x111111;
     size_t low_freq_type = 3002;
-    size_t low_freq_vptr = 0x222222;
+    int low_freq_vptr = 0x222222;
 
     // Insert high frequency entry
     for (int i = 0; i < MAP_MIGRATE_MIN_FREQ + 1; i++)
     {
         hm_keyv_t kv = {.class_id = high_freq_type, .vptr = high_freq_vptr};
-        hm_insert(&record_cache.hashmap, kv, i + 1);
+        record_cache.table.insert(kv, i + 1);
     }
 
     // Insert low frequency entry
     hm_keyv_t kv = {.class_id = low_freq_type, .vptr = low_freq_vptr};
-    hm_insert(&record_cache.hashmap, kv, 1);
+    record_cache.table.insert(kv, 1);
 
     // Trigger migration
-    transfer_high_freq_entries(&verify_cache.hashmap, &record_cache.hashmap, MAP_MIGRATE_MIN_FREQ);
+    transfer_high_freq_entries(&verify_cache.table, &record_cache.table, MAP_MIGRATE_MIN_FREQ);
 
     // Verify results
     hm_keyv_t high_freq_sig = {.class_id = high_freq_type, .vptr = high_freq_vptr};
     hm_keyv_t low_freq_sig = {.class_id = low_freq_type, .vptr = low_freq_vptr};
 
-    bool high_migrated = hm_find(&verify_cache.hashmap, high_freq_sig) != NULL;
-    bool low_not_migrated = hm_find(&verify_cache.hashmap, low_freq_sig) == NULL;
+    bool high_migrated = verify_cache.table.find(high_freq_sig) != NULL;
+    bool low_not_migrated = verify_cache.table.find(low_freq_sig) == NULL;
 
     bool passed = high_migrated && low_not_migrated;
     print_test_result("Test high frequency entry migration", passed);
@@ -137,41 +137,42 @@ void test_high_frequency_migration()
         tests_failed++;
 }
 
-// 6. Test Verify Cache Eviction (FIFO)
+// 6. Test Verify Cache Eviction (CLOCK)
 void test_verify_cache_eviction()
 {
-#define NUM_EACH_GENERATION 40
+#define NUM_HOT_ENTRIES 10
 
-    hm_clear(&verify_cache.hashmap);
+    verify_cache.table.clear();
 
-    int remain = VERIFY_GROUP_NUM * HM_GROUP_SIZE;
-    assert(verify_cache.hashmap.metainfo.oldest_generation == 1 && "Initial oldest generation should be 1");
-    verify_cache.hashmap.metainfo.newest_generation = 0;
-    // Store oldest generation
-    int oldest_gen = verify_cache.hashmap.metainfo.oldest_generation;
+    int limit = VERIFY_GROUP_NUM * HM_GROUP_SIZE;
+    bool bounded = true;
+    bool hot_kept = true;
 
-    // Fill verify cache to trigger eviction
-    for (int i = 0; i < VERIFY_GROUP_NUM * HM_GROUP_SIZE; i++)
+    // Churn through three times the capacity while the first entries stay hot.
+    for (int i = 0; i < 3 * limit; i++)
     {
-        if (i % NUM_EACH_GENERATION == 0)
-            verify_cache.hashmap.metainfo.newest_generation++;
-
-        hm_keyv_t kv = {.class_id = ((0x4000ul + i) << 31), .vptr = 0x1000ul + i};
-        hm_insert(&verify_cache.hashmap, kv, i);
-
-        if (verify_cache.hashmap.metainfo.oldest_generation == oldest_gen + 1)
-        { // evicted.
-            remain -= NUM_EACH_GENERATION;
-            oldest_gen = verify_cache.hashmap.metainfo.oldest_generation;
+        int items = verify_cache.table.items;
+        hm_keyv_t kv = {.class_id = ((0x4000ul + i) << 31), .vptr = 0x1000 + i};
+        verify_cache.table.insert(kv, i);
+
+        // Each insert frees at most MAP_EVICT_MIN_COUNT entries and never fills the table.
+        if (verify_cache.table.items < items + 1 - MAP_EVICT_MIN_COUNT ||
+            verify_cache.table.items > limit - HM_GROUP_SIZE)
+            bounded = false;
+
+        for (int h = 0; h < NUM_HOT_ENTRIES && h <= i; h++)
+        {
+            hm_keyv_t hot = {.class_id = ((0x4000ul + h) << 31), .vptr = 0x1000 + h};
+            hm_keyv_t *ref = verify_cache.table.find(hot);
+            if (ref)
+                verify_cache.table.touch(ref);
+            else
+                hot_kept = false;
         }
     }
 
-    bool be_evicted = verify_cache.hashmap.items == remain;
-    // Verify oldest generation was incremented
-    bool expected = (verify_cache.hashmap.metainfo.oldest_generation - 1) * NUM_EACH_GENERATION == VERIFY_GROUP_NUM * HM_GROUP_SIZE - remain;
-    bool oldest_gen_correct = verify_cache.hashmap.metainfo.oldest_generation < verify_cache.hashmap.metainfo.newest_generation;
-    bool passed = be_evicted && expected && oldest_gen_correct;
-    print_test_result("Test verify cache FIFO eviction", passed);
+    bool passed = bounded && hot_kept;
+    print_test_result("Test verify cache CLOCK eviction", passed);
     if (passed)
         tests_passed++;
     else
@@ -181,29 +182,38 @@ void test_verify_cache_eviction()
 // 7. Test Record Cache Eviction (Frequency)
 void test_record_cache_eviction()
 {
-    hm_clear(&record_cache.hashmap);
+    record_cache.table.clear();
+
+    int limit = RECORD_GROUP_NUM * HM_GROUP_SIZE;
+    bool bounded = true;
 
-    int remain = RECORD_GROUP_NUM * HM_GROUP_SIZE;
-    int count = 0;
-    // Fill record cache with low frequency entries
-    for (int i = 0; i < RECORD_GROUP_NUM * HM_GROUP_SIZE; i++)
+    // One high frequency entry among a stream of low frequency ones
+    hm_keyv_t high = {.class_id = 6000, .vptr = 0x3000};
+    record_cache.table.insert(high, MAP_EVICT_MIN_COUNT * 2);
+    for (int i = 1; i < 3 * limit; i++)
     {
-        hm_keyv_t kv = {.class_id = 6000 + i, .vptr = 0x3000 + i};
-        if (i == 0)
-            hm_insert(&record_cache.hashmap, kv, MAP_EVICT_MIN_COUNT * 2); // high frequency
-        else
-            hm_insert(&record_cache.hashmap, kv, 1); // Low frequency
-
-        if (record_cache.hashmap.items == 2)
-        { // evicted or inserted the first 2 elements.
-            remain -= count;
-            count = 0;
-        }
-        count++;
+        int items = record_cache.table.items;
+        hm_keyv_t kv = {.class_id = 6000ul + i, .vptr = 0x3000 + i};
+        record_cache.table.insert(kv, 1); // Low frequency
+
+        if (record_cache.table.items < items + 1 - MAP_EVICT_MIN_COUNT ||
+            record_cache.table.items > limit - HM_GROUP_SIZE)
+            bounded = false;
+    }
+    bool high_kept = record_cache.table.find(high) != NULL;
+
+    // Once only high frequency entries are left, inserts still find room.
+    record_cache.table.clear();
+    for (int i = 0; i < 3 * limit; i++)
+    {
+        hm_keyv_t kv = {.class_id = 7000ul + i, .vptr = 0x5000 + i};
+        record_cache.table.insert(kv, MAP_EVICT_MIN_COUNT * 2);
+
+        if (record_cache.table.items > limit - HM_GROUP_SIZE)
+            bounded = false;
     }
 
-    // Verify all old entries are evicted;
-    bool passed = record_cache.hashmap.items == remain + 1;
+    bool passed = bounded && high_kept;
     print_test_result("Test record cache frequency eviction", passed);
     if (passed)
         tests_passed++;
@@ -220,7 +230,7 @@ int main()
     test_hash_function();
     test_key_comparison();
 
-    // // VCFI verification tests
+    // VCFI verification tests
     test_basic_vcall_validation();
     test_vcall_migration_threshold();
     test_high_frequency_migration();
@@ -0,0 +1,411 @@
+#include "xvcfiopt/cfi_xdso_cache.cpp"
+#include "xvcfiopt/xvcfiopt_flags.cpp"
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <x86intrin.h>
+
+// Microbenchmarks of the verify/record tables and of __cfi_slowpath.
+//
+// Builds the xvcfiopt runtime itself (compiler-rt/lib/xvcfiopt) at -O2, on
+// top of the sanitizer_common stand-ins in runtime_stubs/, with its default
+// flags: read-only verify table, module tags and all. It times hits, misses,
+// inserts, reductions, migrations and the slowpath for several load factors
+// and key distributions. A sample times a batch of
+// operations with the TSC; the report gives percentiles of ns/op and of TSC
+// cycles/op over all samples of a case.
+//
+// Usage: make bench_hashmap && ./bench_hashmap [samples]
+
+#define BATCH_SIZE 32        // Operations timed together in one sample
+#define DEFAULT_SAMPLES 2000 // Samples per case
+#define ABSENT_VPTR 0x4000000 // Offset of the vtables no signature refers to
+
+typedef struct
+{
+    const char *name;
+    int n_types; // Interfaces called through, 0 for random keys
+} key_shape_t;
+
+static const key_shape_t key_shapes[] = {
+    {"uniform", 0},
+    {"mixed", 16},
+    {"megamorphic", 1},
+};
+
+// Fractions of the table filled before timing; reduction starts at HM_LOAD_FACTOR.
+static const int load_pcts[] = {25, 50, 70};
+
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
+static int n_samples = DEFAULT_SAMPLES;
+static double tsc_per_ns;
+static volatile uintptr_t sink; // Keeps lookups from being optimized away
+
+// The one module registered with the runtime. It spans the whole 32-bit vptr
+// space, so that every signature migrates with its tag.
+#define BENCH_MODULE_END 0x100000000ul
+static const char bench_module_id = 0;
+
+//-----------------------------Begin: Keys and timing-------------------------------------
+static uint64_t mix64(uint64_t x)
+{
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ul;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebul;
+    return x ^ (x >> 31);
+}
+
+// The i-th signature of a shape. Absent signatures use vtables that no
+// present signature uses, so they miss in every table.
+static hm_keyv_t make_key(const key_shape_t *shape, int i, bool absent)
+{
+    hm_keyv_t kv;
+    if (shape->n_types == 0)
+    {
+        uint64_t r = mix64(2 * (uint64_t)i + absent);
+        kv.class_id = r;
+        kv.vptr = (int)(r >> 32);
+    }
+    else
+    {
+        int type = i % shape->n_types, vtable = i / shape->n_types;
+        kv.class_id = ((size_t)(type + 1) * 0xd6e8feb86659fd93ul) ^ 0x5bd1e9955bd1e995ul;
+        kv.vptr = 0x5a3010 + type * 0x10000 + vtable * 0x38 + (absent ? ABSENT_VPTR : 0);
+    }
+    kv.data = 0;
+    return kv;
+}
+
+// Fill keys with n signatures of shape in random order.
+static void make_keys(hm_keyv_t *keys, int n, const key_shape_t *shape, bool absent)
+{
+    for (int i = 0; i < n; i++)
+        keys[i] = make_key(shape, i, absent);
+    for (int i = n - 1; i > 0; i--)
+    {
+        int j = mix64(i) % (i + 1);
+        hm_keyv_t kv = keys[i];
+        keys[i] = keys[j];
+        keys[j] = kv;
+    }
+}
+
+// The next BATCH_SIZE signatures of shape from *next on, made before timing.
+static void make_batch(hm_keyv_t *batch, const key_shape_t *shape, int *next, bool absent)
+{
+    for (int b = 0; b < BATCH_SIZE; b++)
+        batch[b] = make_key(shape, (*next)++, absent);
+}
+
+static inline uint64_t tsc_begin()
+{
+    _mm_lfence();
+    return __rdtsc();
+}
+
+static inline uint64_t tsc_end()
+{
+    unsigned aux;
+    uint64_t t = __rdtscp(&aux);
+    _mm_lfence();
+    return t;
+}
+
+static uint64_t now_ns()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ul + ts.tv_nsec;
+}
+
+// TSC ticks per nanosecond, measured over 50ms.
+static double calibrate_tsc()
+{
+    uint64_t ns0 = now_ns(), tsc0 = tsc_begin();
+    while (now_ns() - ns0 < 50000000ul)
+        ;
+    uint64_t ns1 = now_ns(), tsc1 = tsc_end();
+    return (double)(tsc1 - tsc0) / (ns1 - ns0);
+}
+//------------------------------End: Keys and timing--------------------------------------
+
+//-------------------------------Begin: Reporting-----------------------------------------
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static double percentile(const double *sorted, int n, double pct)
+{
+    int idx = (int)(pct / 100 * (n - 1) + 0.5);
+    return sorted[idx];
+}
+
+// Print one case; samples hold TSC cycles per operation and are sorted in place.
+static void report(const char *op, const char *shape, const char *load, double *samples, int n)
+{
+    qsort(samples, n, sizeof(double), compare_double);
+
+    static const double pcts[] = {50, 90, 99, 99.9};
+    printf("%-13s %-12s %5s |", op, shape, load);
+    for (size_t i = 0; i < ARRAY_SIZE(pcts); i++)
+        printf(" %7.1f", percentile(samples, n, pcts[i]) / tsc_per_ns);
+    printf(" |");
+    for (size_t i = 0; i < ARRAY_SIZE(pcts); i++)
+        printf(" %7.0f", percentile(samples, n, pcts[i]));
+    printf("\n");
+}
+
+static void print_header()
+{
+    printf("%-13s %-12s %5s | %-31s | %-31s\n", "", "", "", "ns/op", "TSC cycles/op");
+    printf("%-13s %-12s %5s | %7s %7s %7s %7s | %7s %7s %7s %7s\n", "operation", "keys", "load",
+           "p50", "p90", "p99", "p99.9", "p50", "p90", "p99", "p99.9");
+}
+//--------------------------------End: Reporting------------------------------------------
+
+//------------------------------Begin: Benchmarks-----------------------------------------
+// Start the runtime with its default flags, register the bench module and
+// map the tables with a first miss.
+static void init_runtime()
+{
+    __xvcfiopt::flags()->SetDefaults();
+    __xvcfiopt::InitAsPlugin();
+    __xvcfiopt::BeginModuleUpdate();
+    __xvcfiopt::AddModule(&bench_module_id, "bench", 0, BENCH_MODULE_END);
+    __xvcfiopt::EndModuleUpdate();
+    __cfi_slowpath(0, NULL);
+}
+
+// The verify table is read-only outside of migrations; the benchmarks that
+// write it directly lift that, untimed.
+static void clear_verify()
+{
+    set_verify_map_writable(g_verify_map, true);
+    g_verify_map->clear();
+    set_verify_map_writable(g_verify_map, false);
+}
+
+// Fill the verify table with the first n signatures of shape, tagged like
+// migrated ones.
+static void fill_verify(const key_shape_t *shape, int n)
+{
+    set_verify_map_writable(g_verify_map, true);
+    g_verify_map->clear();
+    for (int i = 0; i < n; i++)
+    {
+        hm_keyv_t kv = make_key(shape, i, false);
+        int tag;
+        module_tag_of(kv, &tag);
+        g_verify_map->insert(kv, tag);
+    }
+    set_verify_map_writable(g_verify_map, false);
+}
+
+// Lookups of the present (hit) or absent (miss) signatures of a filled table.
+static void bench_find(const key_shape_t *shape, int n_keys, const char *load, bool hit, double *samples)
+{
+    hm_keyv_t *keys = (hm_keyv_t *)malloc(n_keys * sizeof(hm_keyv_t));
+    make_keys(keys, n_keys, shape, !hit);
+    int next = 0;
+
+    for (int s = 0; s < n_samples; s++)
+    {
+        uintptr_t acc = 0;
+        uint64_t start = tsc_begin();
+        for (int b = 0; b < BATCH_SIZE; b++)
+        {
+            acc += (uintptr_t)g_verify_map->find(keys[next]);
+            next = (next + 1 < n_keys) ? next + 1 : 0;
+        }
+        samples[s] = (double)(tsc_end() - start) / BATCH_SIZE;
+        sink = acc;
+    }
+    report(hit ? "find hit" : "find miss", shape->name, load, samples, n_samples);
+    free(keys);
+}
+
+// Inserts into a table between n_base signatures and the reduction threshold.
+static void bench_insert(const key_shape_t *shape, int n_base, const char *load, double *samples)
+{
+    hm_verify_map_t *map = g_verify_map;
+    hm_keyv_t batch[BATCH_SIZE];
+    int next = n_base;
+
+    fill_verify(shape, n_base);
+    set_verify_map_writable(map, true);
+    for (int s = 0; s < n_samples; s++)
+    {
+        if ((map->items + BATCH_SIZE) * 100 >= map->tune().load_factor_pct * map->size())
+        {
+            fill_verify(shape, n_base); // Not timed
+            set_verify_map_writable(map, true);
+            next = n_base;
+        }
+        make_batch(batch, shape, &next, false);
+
+        uint64_t start = tsc_begin();
+        for (int b = 0; b < BATCH_SIZE; b++)
+            map->insert(batch[b], 0);
+        samples[s] = (double)(tsc_end() - start) / BATCH_SIZE;
+    }
+    set_verify_map_writable(map, false);
+    report("insert", shape->name, load, samples, n_samples);
+}
+
+// Inserts into a full table, each paying its share of reductions and compactions.
+static void bench_insert_full(const key_shape_t *shape, double *samples)
+{
+    hm_verify_map_t *map = g_verify_map;
+    hm_keyv_t batch[BATCH_SIZE];
+    int next = 0;
+
+    set_verify_map_writable(map, true);
+    map->clear();
+    while (!map->should_reduce())
+        map->insert(make_key(shape, next++, false), 0);
+
+    for (int s = 0; s < n_samples; s++)
+    {
+        make_batch(batch, shape, &next, false);
+
+        uint64_t start = tsc_begin();
+        for (int b = 0; b < BATCH_SIZE; b++)
+            map->insert(batch[b], 0);
+        samples[s] = (double)(tsc_end() - start) / BATCH_SIZE;
+    }
+    set_verify_map_writable(map, false);
+    report("insert full", shape->name, "full", samples, n_samples);
+}
+
+// One reduction of a table at the reduction threshold per sample.
+static void bench_reduce(const key_shape_t *shape, double *samples)
+{
+    hm_verify_map_t *map = g_verify_map;
+    int next = 0;
+
+    set_verify_map_writable(map, true);
+    map->clear();
+    for (int s = 0; s < n_samples; s++)
+    {
+        while (!map->should_reduce()) // Not timed
+            map->insert(make_key(shape, next++, false), 0);
+
+        uint64_t start = tsc_begin();
+        map->reduce();
+        samples[s] = (double)(tsc_end() - start);
+    }
+    set_verify_map_writable(map, false);
+    report("reduce", shape->name, "full", samples, n_samples);
+}
+
+// One migration per sample of a record table filled to n_keys signatures,
+// a quarter of them hot enough to migrate. It includes the mprotect calls
+// around the transfer and the module tagging.
+static void bench_migrate(const key_shape_t *shape, int n_keys, const char *load, double *samples)
+{
+    int next = 0;
+    clear_verify();
+    for (int s = 0; s < n_samples; s++)
+    {
+        g_record_map->clear(); // Not timed
+        for (int i = 0; i < n_keys; i++, next++)
+            g_record_map->insert(make_key(shape, next, false), (i % 4 == 0) ? hm_tuning.migrate_min_freq + 1 : 1);
+
+        uint64_t start = tsc_begin();
+        migrate_vcall_signature(g_verify_map, g_record_map);
+        samples[s] = (double)(tsc_end() - start);
+    }
+    report("migrate", shape->name, load, samples, n_samples);
+}
+
+// __cfi_slowpath on the signatures of a filled verify table.
+static void bench_slowpath_hit(const key_shape_t *shape, int n_keys, const char *load, double *samples)
+{
+    hm_keyv_t *keys = (hm_keyv_t *)malloc(n_keys * sizeof(hm_keyv_t));
+    make_keys(keys, n_keys, shape, false);
+    int next = 0;
+
+    for (int s = 0; s < n_samples; s++)
+    {
+        uint64_t start = tsc_begin();
+        for (int b = 0; b < BATCH_SIZE; b++)
+        {
+            __cfi_slowpath(keys[next].class_id, (void *)(long)keys[next].vptr);
+            next = (next + 1 < n_keys) ? next + 1 : 0;
+        }
+        samples[s] = (double)(tsc_end() - start) / BATCH_SIZE;
+    }
+    report("slowpath hit", shape->name, load, samples, n_samples);
+    free(keys);
+}
+
+// __cfi_slowpath on signatures never seen before, including their recording
+// and the migrations they trigger.
+static void bench_slowpath_miss(const key_shape_t *shape, double *samples)
+{
+    hm_keyv_t batch[BATCH_SIZE];
+    int next = 0;
+
+    clear_verify();
+    g_record_map->clear();
+    for (int s = 0; s < n_samples; s++)
+    {
+        make_batch(batch, shape, &next, true);
+
+        uint64_t start = tsc_begin();
+        for (int b = 0; b < BATCH_SIZE; b++)
+            __cfi_slowpath(batch[b].class_id, (void *)(long)batch[b].vptr);
+        samples[s] = (double)(tsc_end() - start) / BATCH_SIZE;
+    }
+    report("slowpath miss", shape->name, "-", samples, n_samples);
+}
+//-------------------------------End: Benchmarks------------------------------------------
+
+int main(int argc, char **argv)
+{
+    if (argc > 1)
+        n_samples = atoi(argv[1]);
+    if (n_samples <= 0)
+    {
+        fprintf(stderr, "Usage: %s [samples]\n", argv[0]);
+        return 1;
+    }
+
+    init_runtime();
+    tsc_per_ns = calibrate_tsc();
+    double *samples = (double *)malloc(n_samples * sizeof(double));
+
+    printf("verify_cache %d groups, record_cache %d groups, %d-slot groups, TSC %.2f GHz\n",
+           g_verify_map->n_groups(), g_record_map->n_groups(), HM_GROUP_SIZE, tsc_per_ns);
+    printf("%d samples per case, %d operations per sample unless one per sample\n\n", n_samples, BATCH_SIZE);
+    print_header();
+
+    for (size_t k = 0; k < ARRAY_SIZE(key_shapes); k++)
+    {
+        const key_shape_t *shape = &key_shapes[k];
+        for (size_t l = 0; l < ARRAY_SIZE(load_pcts); l++)
+        {
+            char load[8];
+            snprintf(load, sizeof(load), "%d%%", load_pcts[l]);
+
+            int n_verify = g_verify_map->size() * load_pcts[l] / 100;
+            fill_verify(shape, n_verify);
+            bench_find(shape, n_verify, load, true, samples);
+            bench_find(shape, n_verify, load, false, samples);
+            bench_slowpath_hit(shape, n_verify, load, samples);
+            bench_insert(shape, n_verify, load, samples);
+
+            int n_record = g_record_map->size() * load_pcts[l] / 100;
+            bench_migrate(shape, n_record, load, samples);
+        }
+        bench_insert_full(shape, samples);
+        bench_reduce(shape, samples);
+        bench_slowpath_miss(shape, samples);
+        printf("\n");
+    }
+
+    free(samples);
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "cfi_xdso_cache.cpp"
+#include <stdio.h>
+#include <stdlib.h>
+
+// Probe-length benchmark for the verify_cache hash function.
+//
+// Fills verify_cache with (type, vptr) signatures shaped like the ones a
+// program migrates and reports how many groups a lookup visits, for the
+// current hash_kvpair and for the former class_id ^ vptr hash.
+//
+// Usage: make bench_probe && ./bench_probe
+
+#define MAX_PROBE_BUCKET 8 // Lookups visiting more groups are counted in the last bucket
+
+// The hash used before hash_kvpair mixed vptr into the position bits.
+static size_t hash_xor(hm_keyv_t vcall_sign)
+{
+    return vcall_sign.class_id ^ (size_t)(vcall_sign.vptr);
+}
+
+typedef size_t (*hash_func_t)(hm_keyv_t);
+
+typedef struct
+{
+    const char *name;
+    int n_types; // Interfaces called through
+    int n_vptrs; // Vtables valid for each interface
+} key_set_t;
+
+static const key_set_t key_sets[] = {
+    {"megamorphic: 1 type x 720 vtables", 1, 720},
+    {"hot interfaces: 4 types x 180 vtables", 4, 180},
+    {"mixed: 24 types x 30 vtables", 24, 30},
+    {"monomorphic: 720 types x 1 vtable", 720, 1},
+};
+
+// Type IDs are the leading bytes of an MD5 of the mangled type name, so they
+// look random. Vtables of one hierarchy are packed in .data.rel.ro.
+static hm_keyv_t make_key(int type, int vtable)
+{
+    hm_keyv_t kv = {
+        .class_id = ((size_t)(type + 1) * 0xd6e8feb86659fd93ul) ^ 0x5bd1e9955bd1e995ul,
+        .vptr = 0x5a3010 + type * 0x10000 + vtable * 0x38,
+    };
+    return kv;
+}
+
+// Metadata in the low bits, the position in the upper half, as hm_table::hash_of().
+static hm_hash_t hash_with(hash_func_t hash_func, hm_keyv_t kv)
+{
+    size_t h = hash_func(kv);
+    hm_hash_t hash = {(uint8_t)(HM_FULL | (h & 0x7f)), (uint32_t)(h >> 32)};
+    return hash;
+}
+
+// Number of groups hm_table::find_hashed() visits for kv.
+static int probe_groups(hm_verify_map_t *map, hm_hash_t hash, hm_keyv_t kv)
+{
+    int idx = hash.pos & (map->size() - 1);
+    int group = idx / HM_GROUP_SIZE;
+    hm_verify_map_t::mask_t from = (hm_verify_map_t::mask_t)(~0u << (idx % HM_GROUP_SIZE));
+
+    for (int n_groups = 1;; n_groups++)
+    {
+        hm_verify_map_t::word_t ctrl = map->groups[group].ctrl;
+        for (hm_verify_map_t::mask_t matches = hm_verify_map_t::ctrl_t::match(ctrl, hash.ctrl) & from; matches; matches &= matches - 1)
+            if (kvpair_equals(map->groups[group].keyv[__builtin_ctz(matches)], kv))
+                return n_groups;
+        if (hm_verify_map_t::ctrl_t::match(ctrl, HM_EMPTY) & from)
+            return n_groups;
+
+        group = (group + 1) & (map->n_groups() - 1);
+        from = (hm_verify_map_t::mask_t)~0u;
+    }
+}
+
+static void print_distribution(const char *what, int *histogram, int n_lookups, long total, int max)
+{
+    printf("  %-6s mean %5.2f max %4d |", what, (double)total / n_lookups, max);
+    for (int b = 1; b <= MAX_PROBE_BUCKET; b++)
+        printf(" %s%d:%5.1f%%", b == MAX_PROBE_BUCKET ? ">=" : "", b, 100.0 * histogram[b] / n_lookups);
+    printf("\n");
+}
+
+static void run(const key_set_t *set, const char *hash_name, hash_func_t hash_func)
+{
+    hm_verify_map_t *map = &verify_cache.table;
+    map->clear();
+
+    for (int t = 0; t < set->n_types; t++)
+        for (int v = 0; v < set->n_vptrs; v++)
+        {
+            hm_keyv_t kv = make_key(t, v);
+            map->insert_hashed(hash_with(hash_func, kv), kv);
+        }
+
+    int hit_histogram[MAX_PROBE_BUCKET + 1] = {0}, miss_histogram[MAX_PROBE_BUCKET + 1] = {0};
+    long hit_total = 0, miss_total = 0;
+    int hit_max = 0, miss_max = 0;
+    int n_keys = set->n_types * set->n_vptrs;
+
+    for (int t = 0; t < set->n_types; t++)
+        for (int v = 0; v < set->n_vptrs; v++)
+        {
+            // Lookups of migrated signatures, and of the next vtable of the same types.
+            hm_keyv_t hit = make_key(t, v), miss = make_key(t, v + set->n_vptrs);
+            int n = probe_groups(map, hash_with(hash_func, hit), hit);
+            int m = probe_groups(map, hash_with(hash_func, miss), miss);
+
+            hit_histogram[n < MAX_PROBE_BUCKET ? n : MAX_PROBE_BUCKET]++;
+            miss_histogram[m < MAX_PROBE_BUCKET ? m : MAX_PROBE_BUCKET]++;
+            hit_total += n;
+            miss_total += m;
+            hit_max = n > hit_max ? n : hit_max;
+            miss_max = m > miss_max ? m : miss_max;
+        }
+
+    printf("%s, %s hash, load %d%%\n", set->name, hash_name, 100 * map->items / map->size());
+    print_distribution("hit", hit_histogram, n_keys, hit_total, hit_max);
+    print_distribution("miss", miss_histogram, n_keys, miss_total, miss_max);
+}
+
+int main()
+{
+    printf("Groups visited per lookup in a %d-group verify_cache\n\n", VERIFY_GROUP_NUM);
+    for (size_t i = 0; i < sizeof(key_sets) / sizeof(key_sets[0]); i++)
+    {
+        run(&key_sets[i], "xor", hash_xor);
+        run(&key_sets[i], "mixed", hash_kvpair);
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,144 @@
+// cfi_optimizer_wrapper.cpp
+#include <stdint.h>
+#include <stdio.h>
+
+#include "swiss_table.h"
+
+// Every slowpath call is traced to stdout, unless built with -DXVCFI_NO_TRACE.
+#ifdef XVCFI_NO_TRACE
+#define XVCFI_TRACE(...) ((void)0)
+#else
+#define XVCFI_TRACE(...) printf(__VA_ARGS__)
+#endif
+
+using namespace __xvcfiopt;
+
+//------------------------Begin: Model-level data structures------------------------------
+#define PAGE_SIZE 4096 // Assuming a page size of 4096 bytes
+// Helper macro to round up to system page size
+#define ROUND_TO_PAGESIZE(size) ((size + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
+
+// A hashmap for recording VCALL signatures
+#define RECORD_GROUP_NUM 8 // 8 groups for recording, ~1 pages
+typedef hm_table<HM_GROUP_SIZE, HM_TYPE_RECORD, hm_fixed_capacity<RECORD_GROUP_NUM>> hm_record_map_t;
+typedef hm_table_storage<hm_record_map_t, RECORD_GROUP_NUM, PAGE_SIZE> hm_recordcache_layout_t;
+
+// A hashmap for verifying VCALL signatures
+#define VERIFY_GROUP_NUM 64 // 64 groups for verification, ~7 pages
+typedef hm_table<HM_GROUP_SIZE, HM_TYPE_VERIFY, hm_fixed_capacity<VERIFY_GROUP_NUM>> hm_verify_map_t;
+typedef hm_table_storage<hm_verify_map_t, VERIFY_GROUP_NUM, PAGE_SIZE> hm_verifycache_layout_t;
+//-------------------------End: Model-level data structures-------------------------------
+
+//-----------------------Begin: Define global variables-----------------------------------
+// Zero-filled tables are empty, so only the referenced bits need an initializer.
+static hm_recordcache_layout_t record_cache;
+
+// Referenced bits of verify_cache, outside of its read-only pages.
+static hm_verify_map_t::mask_t verify_cache_ref_bits[VERIFY_GROUP_NUM];
+
+static hm_verifycache_layout_t verify_cache = {
+    .table = {.ref_bits = verify_cache_ref_bits},
+};
+//-------------------------End: Define global variables-----------------------------------
+
+//-----------------Begin: Functions for VCFI verification---------------------------------
+static bool track_vcall_signature(hm_record_map_t *map_ref, hm_keyv_t keyv)
+{
+    // Return true if this entry is high frequency
+    return map_ref->track(keyv) > (CACHE_MISS_THRESHOLD / 5);
+}
+
+// Transfer high frequency entries from src_map to dest_map
+static bool transfer_high_freq_entries(hm_verify_map_t *verify_map, hm_record_map_t *record_map, int freq)
+{
+    // Make the verify_map writable during migration
+    // mprotect(verify_map, sizeof(verify_cache), PROT_READ | PROT_WRITE);
+    verify_map->transfer_from(record_map, freq);
+    // mprotect(verify_map, sizeof(verify_cache), PROT_READ);
+    return true;
+}
+
+// Add all VCALL signatures from recording map to validating map
+static void migrate_vcall_signature(hm_verify_map_t *verify_map, hm_record_map_t *record_map)
+{
+    transfer_high_freq_entries(verify_map, record_map, MAP_MIGRATE_MIN_FREQ);
+    // Clear the record_map after migration
+    record_map->clear();
+}
+//------------------End: Functions for VCFI verification----------------------------------
+
+static volatile bool g_cache_enabled = true;
+static volatile bool g_record_cache_lock = false; // false means unlocked
+static int g_cache_miss_counter = 0;
+
+// extern "C"
+void __cfi_slowpath_orig(uint64_t CallSiteTypeId, void *Ptr) {}
+
+/**
+ * Checks if the vcall signature (type_id, vptr) exists in the verification
+ * cache. If not found, inserts it into the record cache and may trigger
+ * migration of high-frequency entries.
+ *
+ * @param type_id The type identifier for the vcall class.
+ * @param vptr The virtual pointer value for the vtable pointer.
+ */
+// extern "C"
+void __cfi_slowpath(uint64_t TypeId, void *Ptr)
+{
+    // If cache is temporarily disabled for migration, fallback to original slowpath.
+    if (!g_cache_enabled)
+    { // Reading the non-atomic, volatile bool
+        __cfi_slowpath_orig(TypeId, Ptr);
+        return;
+    }
+
+    // VCall signature to check in the verification cache.
+    hm_keyv_t vcall_signature = {.class_id = TypeId, .vptr = (int)(long)Ptr};
+
+    // Verify with the cache table.
+    hm_keyv_t *sign = verify_cache.table.find(vcall_signature);
+
+    // On cache hit, the call is considered valid. Return immediately.
+    if (sign)
+    {
+        verify_cache.table.touch(sign);
+        XVCFI_TRACE("Cache hit: TypeId=0x%lx, vptr=0x%x\n", TypeId, (int)(long)Ptr);
+        return;
+    }
+
+    // --- Cache Miss ---
+    g_cache_miss_counter++;
+
+    // Attempt to acquire the lock to access the recording table (non-blocking).
+    // test_and_set returns the *previous* value. If it was false (unlocked), the
+    // condition is true and we enter the critical section.
+    if (!__atomic_test_and_set(&g_record_cache_lock, __ATOMIC_ACQUIRE))
+    {
+        // --- Lock Acquired ---
+        XVCFI_TRACE("Cache miss: TypeId=0x%lx, vptr=0x%x\n", TypeId, (int)(long)Ptr);
+        bool hot_miss = track_vcall_signature(&record_cache.table, vcall_signature);
+
+        if (hot_miss || (g_cache_miss_counter > CACHE_MISS_THRESHOLD))
+        {
+            // Disable cache to begin migration. This write is not thread-safe.
+            g_cache_enabled = false;
+
+            // Migrate high-frequency signatures from the recording cache to the verification cache.
+            migrate_vcall_signature(&verify_cache.table, &record_cache.table);
+
+            // Re-enable cache and reset the counter. This write is not thread-safe.
+            g_cache_enabled = true;
+            g_cache_miss_counter = 0;
+        }
+
+        // Release the lightweight lock.
+        __atomic_clear(&g_record_cache_lock, __ATOMIC_RELEASE);
+    }
+
+    // Fallback to the original slow path for this VCall.
+    __cfi_slowpath_orig(TypeId, Ptr);
+}
+
+// This unique "anchor" function forces the linker to include this object file.
+// extern "C"
+void __cfi_force_link_xdso_optimizer(void) {}
\ No newline at end of file
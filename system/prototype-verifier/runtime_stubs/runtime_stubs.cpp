@@ -0,0 +1,204 @@
+// runtime_stubs.cpp
+//
+// libc implementations of the sanitizer_common stand-ins (see
+// sanitizer_common/sanitizer_common.h), and the original slowpath, which only
+// counts its calls: every signature is valid.
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "sanitizer_common/sanitizer_common.h"
+#include "sanitizer_common/sanitizer_file.h"
+#include "sanitizer_common/sanitizer_posix.h"
+
+namespace __sanitizer
+{
+
+void Printf(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vprintf(format, ap);
+    va_end(ap);
+}
+
+void Report(const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+}
+
+// VERBOSITY=<n> in the environment stands for CFI_OPTIONS=verbosity=<n>.
+int Verbosity()
+{
+    const char *verbosity = getenv("VERBOSITY");
+    return verbosity ? atoi(verbosity) : 0;
+}
+
+int Atexit(void (*function)(void))
+{
+    return atexit(function);
+}
+
+void Die()
+{
+    abort();
+}
+
+void *MmapOrDie(uptr size, const char *mem_type, bool raw_report)
+{
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED)
+    {
+        Report("ERROR: failed to map %lu bytes of %s\n", size, mem_type);
+        Die();
+    }
+    return p;
+}
+
+void *MmapNoReserveOrDie(uptr size, const char *mem_type)
+{
+    return MmapOrDie(size, mem_type);
+}
+
+void UnmapOrDie(void *addr, uptr size)
+{
+    munmap(addr, size);
+}
+
+uptr GetPageSizeCached()
+{
+    return sysconf(_SC_PAGESIZE);
+}
+
+int internal_strcmp(const char *s1, const char *s2)
+{
+    return strcmp(s1, s2);
+}
+
+void internal_memcpy(void *dest, const void *src, uptr n)
+{
+    memcpy(dest, src, n);
+}
+
+void internal_memset(void *s, int c, uptr n)
+{
+    memset(s, c, n);
+}
+
+int internal_snprintf(char *buffer, uptr length, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap, format);
+    int n = vsnprintf(buffer, length, format, ap);
+    va_end(ap);
+    return n;
+}
+
+uptr internal_getpid()
+{
+    return getpid();
+}
+
+uptr internal_sched_yield()
+{
+    return syscall(SYS_sched_yield);
+}
+
+// The wrappers return -errno on failure, as the raw syscalls do.
+static uptr raw_result(long res)
+{
+    return res == -1 ? (uptr)-errno : (uptr)res;
+}
+
+uptr internal_mmap(void *addr, uptr length, int prot, int flags, int fd, u64 offset)
+{
+    return raw_result(syscall(SYS_mmap, addr, length, prot, flags, fd, offset));
+}
+
+uptr internal_kill(int pid, int sig)
+{
+    return raw_result(syscall(SYS_kill, pid, sig));
+}
+
+bool internal_iserror(uptr retval, int *rverrno)
+{
+    if (retval >= (uptr)-4095)
+    {
+        if (rverrno)
+            *rverrno = -(int)retval;
+        return true;
+    }
+    return false;
+}
+
+u64 NanoTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+u64 MonotonicNanoTime()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+void Semaphore::Wait()
+{
+    while (true)
+    {
+        unsigned count = __atomic_load_n(&state_, __ATOMIC_RELAXED);
+        if (count && __atomic_compare_exchange_n(&state_, &count, count - 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            return;
+        if (!count)
+            syscall(SYS_futex, &state_, FUTEX_WAIT_PRIVATE, 0, NULL, NULL, 0);
+    }
+}
+
+void Semaphore::Post(unsigned count)
+{
+    __atomic_fetch_add(&state_, count, __ATOMIC_RELEASE);
+    syscall(SYS_futex, &state_, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+}
+
+fd_t OpenFile(const char *filename, FileAccessMode mode, int *errno_p)
+{
+    static const int flags[] = {O_RDONLY, O_WRONLY | O_CREAT | O_TRUNC, O_RDWR | O_CREAT};
+    return open(filename, flags[mode], 0660);
+}
+
+void CloseFile(fd_t fd)
+{
+    close(fd);
+}
+
+bool WriteToFile(fd_t fd, const void *buff, uptr buff_size, uptr *bytes_written, int *error_p)
+{
+    ssize_t n = write(fd, buff, buff_size);
+    if (bytes_written)
+        *bytes_written = n < 0 ? 0 : n;
+    return n == (ssize_t)buff_size;
+}
+
+} // namespace __sanitizer
+
+long g_slowpath_orig_calls = 0;
+
+extern "C" void __cfi_slowpath_orig(uint64_t CallSiteTypeId, void *Ptr)
+{
+    g_slowpath_orig_calls++;
+}
@@ -0,0 +1,59 @@
+// sanitizer_common.h
+//
+// Stand-in for the parts of compiler-rt's sanitizer_common that the xvcfiopt
+// runtime uses, so that compiler-rt/lib/xvcfiopt/cfi_xdso_cache.cpp builds
+// and runs outside of compiler-rt. Declarations follow the real ones;
+// runtime_stubs.cpp implements them on top of libc.
+#ifndef SANITIZER_COMMON_H
+#define SANITIZER_COMMON_H
+
+namespace __sanitizer
+{
+
+typedef unsigned long uptr;
+typedef unsigned long long u64;
+
+void Printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+void Report(const char *format, ...) __attribute__((format(printf, 1, 2)));
+int Verbosity();
+int Atexit(void (*function)(void));
+void Die();
+
+void *MmapOrDie(uptr size, const char *mem_type, bool raw_report = false);
+void *MmapNoReserveOrDie(uptr size, const char *mem_type);
+void UnmapOrDie(void *addr, uptr size);
+uptr GetPageSizeCached();
+
+int internal_strcmp(const char *s1, const char *s2);
+void internal_memcpy(void *dest, const void *src, uptr n);
+void internal_memset(void *s, int c, uptr n);
+int internal_snprintf(char *buffer, uptr length, const char *format, ...) __attribute__((format(printf, 3, 4)));
+uptr internal_getpid();
+uptr internal_sched_yield();
+u64 NanoTime();
+u64 MonotonicNanoTime();
+bool internal_iserror(uptr retval, int *rverrno = nullptr);
+
+class Semaphore
+{
+  public:
+    constexpr Semaphore() {}
+    void Wait();
+    void Post(unsigned count = 1);
+
+  private:
+    unsigned state_ = 0;
+};
+
+} // namespace __sanitizer
+
+#define SANITIZER_INTERFACE_ATTRIBUTE __attribute__((visibility("default")))
+#define THREADLOCAL __thread
+#define VReport(level, ...)                                    \
+    do                                                         \
+    {                                                          \
+        if ((__sanitizer::uptr)__sanitizer::Verbosity() >= (level)) \
+            __sanitizer::Report(__VA_ARGS__);                  \
+    } while (0)
+
+#endif // SANITIZER_COMMON_H
@@ -0,0 +1,28 @@
+// sanitizer_file.h
+//
+// Stand-in for compiler-rt's sanitizer_file.h, see sanitizer_common.h.
+#ifndef SANITIZER_FILE_H
+#define SANITIZER_FILE_H
+
+#include "sanitizer_common.h"
+
+namespace __sanitizer
+{
+
+typedef int fd_t;
+const fd_t kInvalidFd = -1;
+
+enum FileAccessMode
+{
+    RdOnly,
+    WrOnly,
+    RdWr
+};
+
+fd_t OpenFile(const char *filename, FileAccessMode mode, int *errno_p = nullptr);
+void CloseFile(fd_t fd);
+bool WriteToFile(fd_t fd, const void *buff, uptr buff_size, uptr *bytes_written = nullptr, int *error_p = nullptr);
+
+} // namespace __sanitizer
+
+#endif // SANITIZER_FILE_H
@@ -0,0 +1,22 @@
+// sanitizer_flag_parser.h
+//
+// Stand-in for compiler-rt's sanitizer_flag_parser.h, see sanitizer_common.h.
+// Flags keep their defaults; programs set them through flags() directly.
+#ifndef SANITIZER_FLAG_PARSER_H
+#define SANITIZER_FLAG_PARSER_H
+
+namespace __sanitizer
+{
+
+class FlagParser
+{
+};
+
+template <typename T>
+static void RegisterFlag(FlagParser *parser, const char *name, const char *desc, T *var)
+{
+}
+
+} // namespace __sanitizer
+
+#endif // SANITIZER_FLAG_PARSER_H
@@ -0,0 +1,19 @@
+// sanitizer_posix.h
+//
+// Stand-in for the POSIX syscall wrappers of compiler-rt's sanitizer_common
+// (see sanitizer_common.h). They return the raw syscall result, to be
+// checked with internal_iserror().
+#ifndef SANITIZER_POSIX_H
+#define SANITIZER_POSIX_H
+
+#include "sanitizer_common.h"
+
+namespace __sanitizer
+{
+
+uptr internal_mmap(void *addr, uptr length, int prot, int flags, int fd, u64 offset);
+uptr internal_kill(int pid, int sig);
+
+} // namespace __sanitizer
+
+#endif // SANITIZER_POSIX_H
@@ -0,0 +1,30 @@
+// ubsan_handlers.h
+//
+// Stand-in for compiler-rt's ubsan_handlers.h, see sanitizer_common.h.
+#ifndef UBSAN_HANDLERS_H
+#define UBSAN_HANDLERS_H
+
+namespace __ubsan
+{
+
+typedef unsigned int u32;
+
+struct SourceLocation
+{
+    const char *Filename;
+    u32 Line;
+    u32 Column;
+
+    bool isDisabled() { return Column == ~u32(0); }
+};
+
+struct CFICheckFailData
+{
+    unsigned char CheckKind;
+    SourceLocation Loc;
+    const void *Type;
+};
+
+} // namespace __ubsan
+
+#endif // UBSAN_HANDLERS_H
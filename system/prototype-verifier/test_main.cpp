@@ -0,0 +1,396 @@
+#include "cfi_xdso_cache.cpp"
+#include <stdio.h>
+
+// Helper function to print test results
+void print_test_result(const char *test_name, bool passed)
+{
+    printf("%-50s %s\n", test_name, passed ? "PASSED" : "FAILED");
+}
+
+// Test case counter
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+// 1. Test Hash Function
+void test_hash_function()
+{
+    hm_keyv_t kv1 = {.class_id = 123, .vptr = 456};
+    hm_keyv_t kv2 = {.class_id = 123, .vptr = 456};
+    hm_keyv_t kv3 = {.class_id = 789, .vptr = 101112};
+
+    size_t hash1 = hash_kvpair(kv1);
+    size_t hash2 = hash_kvpair(kv2);
+    size_t hash3 = hash_kvpair(kv3);
+
+    bool passed = (hash1 == hash2) && (hash1 != hash3);
+    print_test_result("Test hash function consistency", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// 2. Test Key Comparison
+void test_key_comparison()
+{
+    hm_keyv_t kv1 = {.class_id = 123, .vptr = 456};
+    hm_keyv_t kv2 = {.class_id = 123, .vptr = 456};
+    hm_keyv_t kv3 = {.class_id = 123, .vptr = 789};
+
+    bool passed = kvpair_equals(kv1, kv2) && !kvpair_equals(kv1, kv3);
+    print_test_result("Test key comparison", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// 3. Test Basic VCALL Validation
+void test_basic_vcall_validation()
+{
+    size_t type_id = 1001;
+    int vptr = 0xABCDEF;
+
+    // First call should miss and insert into record_cache
+    __cfi_slowpath(type_id, (void *)(long)vptr);
+
+    // Verify it's in record_cache but not verify_cache
+    hm_keyv_t signature = {.class_id = type_id, .vptr = vptr};
+    bool in_record = record_cache.table.find(signature) != NULL;
+    bool in_verify = verify_cache.table.find(signature) != NULL;
+
+    bool passed = in_record && !in_verify;
+    print_test_result("Test basic VCALL validation (first call)", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// 4. Test VCALL Migration Threshold
+void test_vcall_migration_threshold()
+{
+    // Clear caches first
+    record_cache.table.clear();
+    verify_cache.table.clear();
+
+    size_t type_id = 2001;
+    int vptr = 0x123456;
+
+    // Insert CACHE_MISS_THRESHOLD+1 entries to trigger migration
+    for (int i = 0; i < CACHE_MISS_THRESHOLD + 1; i++)
+    {
+        __cfi_slowpath(type_id, (void *)(long)vptr);
+    }
+
+    // Verify signature was migrated to verify_cache
+    hm_keyv_t signature = {.class_id = type_id, .vptr = vptr};
+    bool in_verify = verify_cache.table.find(signature) != NULL;
+    bool record_cleared = record_cache.table.items == 0;
+
+    bool passed = in_verify && record_cleared;
+    print_test_result("Test VCALL migration threshold", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// 5. Test High Frequency Entry Migration
+void test_high_frequency_migration()
+{
+    // Clear caches first
+    record_cache.table.clear();
+    verify_cache.table.clear();
+
+    size_t high_freq_type = 3001;
+    int high_freq_vptr = 0x111111;
+    size_t low_freq_type = 3002;
+    int low_freq_vptr = 0x222222;
+
+    // Insert high frequency entry
+    for (int i = 0; i < MAP_MIGRATE_MIN_FREQ + 1; i++)
+    {
+        hm_keyv_t kv = {.class_id = high_freq_type, .vptr = high_freq_vptr};
+        record_cache.table.insert(kv, i + 1);
+    }
+
+    // Insert low frequency entry
+    hm_keyv_t kv = {.class_id = low_freq_type, .vptr = low_freq_vptr};
+    record_cache.table.insert(kv, 1);
+
+    // Trigger migration
+    transfer_high_freq_entries(&verify_cache.table, &record_cache.table, MAP_MIGRATE_MIN_FREQ);
+
+    // Verify results
+    hm_keyv_t high_freq_sig = {.class_id = high_freq_type, .vptr = high_freq_vptr};
+    hm_keyv_t low_freq_sig = {.class_id = low_freq_type, .vptr = low_freq_vptr};
+
+    bool high_migrated = verify_cache.table.find(high_freq_sig) != NULL;
+    bool low_not_migrated = verify_cache.table.find(low_freq_sig) == NULL;
+
+    bool passed = high_migrated && low_not_migrated;
+    print_test_result("Test high frequency entry migration", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// 6. Test Verify Cache Eviction (CLOCK)
+void test_verify_cache_eviction()
+{
+#define NUM_HOT_ENTRIES 10
+
+    verify_cache.table.clear();
+
+    int limit = VERIFY_GROUP_NUM * HM_GROUP_SIZE;
+    bool bounded = true;
+    bool hot_kept = true;
+
+    // Churn through three times the capacity while the first entries stay hot.
+    for (int i = 0; i < 3 * limit; i++)
+    {
+        int items = verify_cache.table.items;
+        hm_keyv_t kv = {.class_id = ((0x4000ul + i) << 31), .vptr = 0x1000 + i};
+        verify_cache.table.insert(kv, i);
+
+        // Each insert frees at most MAP_EVICT_MIN_COUNT entries and never fills the table.
+        if (verify_cache.table.items < items + 1 - MAP_EVICT_MIN_COUNT ||
+            verify_cache.table.items > limit - HM_GROUP_SIZE)
+            bounded = false;
+
+        for (int h = 0; h < NUM_HOT_ENTRIES && h <= i; h++)
+        {
+            hm_keyv_t hot = {.class_id = ((0x4000ul + h) << 31), .vptr = 0x1000 + h};
+            hm_keyv_t *ref = verify_cache.table.find(hot);
+            if (ref)
+                verify_cache.table.touch(ref);
+            else
+                hot_kept = false;
+        }
+    }
+
+    // With every entry referenced, the hand still holds the load limit.
+    verify_cache.table.clear();
+    int load_limit = (limit * verify_cache.table.tune().load_factor_pct + 99) / 100;
+    bool load_held = true;
+    for (int i = 0; i < 3 * limit; i++)
+    {
+        hm_keyv_t kv = {.class_id = ((0x8000ul + i) << 31), .vptr = 0x3000 + i};
+        verify_cache.table.insert(kv, i);
+        for (int group = 0; group < VERIFY_GROUP_NUM; group++)
+            verify_cache_ref_bits[group] = (hm_verify_map_t::mask_t)~0u;
+        if (verify_cache.table.items > load_limit)
+            load_held = false;
+    }
+
+    bool passed = bounded && hot_kept && load_held;
+    print_test_result("Test verify cache CLOCK eviction", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// 7. Test Record Cache Eviction (Frequency)
+void test_record_cache_eviction()
+{
+    record_cache.table.clear();
+
+    int limit = RECORD_GROUP_NUM * HM_GROUP_SIZE;
+    bool bounded = true;
+
+    // One high frequency entry among a stream of low frequency ones
+    hm_keyv_t high = {.class_id = 6000, .vptr = 0x3000};
+    record_cache.table.insert(high, MAP_EVICT_MIN_COUNT * 2);
+    for (int i = 1; i < 3 * limit; i++)
+    {
+        int items = record_cache.table.items;
+        hm_keyv_t kv = {.class_id = 6000ul + i, .vptr = 0x3000 + i};
+        record_cache.table.insert(kv, 1); // Low frequency
+
+        if (record_cache.table.items < items + 1 - MAP_EVICT_MIN_COUNT ||
+            record_cache.table.items > limit - HM_GROUP_SIZE)
+            bounded = false;
+    }
+    bool high_kept = record_cache.table.find(high) != NULL;
+
+    // Once only high frequency entries are left, inserts still find room.
+    record_cache.table.clear();
+    for (int i = 0; i < 3 * limit; i++)
+    {
+        hm_keyv_t kv = {.class_id = 7000ul + i, .vptr = 0x5000 + i};
+        record_cache.table.insert(kv, MAP_EVICT_MIN_COUNT * 2);
+
+        if (record_cache.table.items > limit - HM_GROUP_SIZE)
+            bounded = false;
+    }
+
+    bool passed = bounded && high_kept;
+    print_test_result("Test record cache frequency eviction", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// 8. Test Tombstone Compaction
+void test_tombstone_compaction()
+{
+    verify_cache.table.clear();
+
+    int limit = VERIFY_GROUP_NUM * HM_GROUP_SIZE;
+    bool bounded = true;
+
+    // Churn until eviction has left tombstones all over the table.
+    for (int i = 0; i < 10 * limit; i++)
+    {
+        hm_keyv_t kv = {.class_id = ((0x9000ul + i) << 31) ^ (i * 0x9e3779b9ul), .vptr = 0x7000 + i};
+        verify_cache.table.insert(kv, i);
+
+        if (verify_cache.table.deleted * 100 > (int)(HM_COMPACT_FACTOR * 100) * limit + 100)
+            bounded = false;
+    }
+
+    verify_cache.table.compact();
+    bool no_tombstones = verify_cache.table.deleted == 0;
+
+    // Every live entry is still found after the rehash, and the counters agree.
+    int idx = 0, live = 0, found = 0;
+    hm_keyv_t *key_ref;
+    while (verify_cache.table.iterate(&idx, &key_ref))
+    {
+        if (key_ref == NULL)
+            continue;
+        live++;
+        if (verify_cache.table.find(*key_ref) == key_ref)
+            found++;
+    }
+
+    // Unknown signatures are rejected instead of probing forever.
+    hm_keyv_t unknown = {.class_id = 0x1234ul << 40, .vptr = 0x4321};
+    bool rejected = verify_cache.table.find(unknown) == NULL;
+
+    bool passed = bounded && no_tombstones && rejected && live == found && live == verify_cache.table.items;
+    print_test_result("Test tombstone compaction", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// 9. Test Portable 8-slot Groups
+void test_portable_groups()
+{
+    typedef hm_table<8, HM_TYPE_VERIFY, hm_fixed_capacity<16>> hm_small_map_t;
+    static hm_table_storage<hm_small_map_t, 16> small_cache;
+    hm_small_map_t *map = &small_cache.table;
+
+    int limit = map->size();
+    bool bounded = true;
+    bool all_found = true;
+
+    // Churn through the table, every entry is found right after its insert.
+    for (int i = 0; i < 5 * limit; i++)
+    {
+        hm_keyv_t kv = {.class_id = ((0xb000ul + i) << 31) ^ (i * 0x9e3779b9ul), .vptr = 0x8000 + i};
+        map->insert(kv, i);
+        if (map->find(kv) == NULL)
+            all_found = false;
+        if (map->items > limit - 8)
+            bounded = false;
+    }
+
+    // The SWAR match agrees with a byte-by-byte comparison.
+    bool matches_agree = true;
+    for (int group = 0; group < map->n_groups(); group++)
+    {
+        uint8_t *ctrl = map->ctrl_bytes(group);
+        uint8_t match_empty = 0, match_full = 0;
+        for (int i = 0; i < 8; i++)
+        {
+            match_empty |= (ctrl[i] == HM_EMPTY) << i;
+            match_full |= ((ctrl[i] & HM_FULL) != 0) << i;
+        }
+        if (hm_small_map_t::ctrl_t::match(map->groups[group].ctrl, HM_EMPTY) != match_empty ||
+            hm_small_map_t::ctrl_t::match_full(map->groups[group].ctrl) != match_full)
+            matches_agree = false;
+    }
+
+    hm_keyv_t unknown = {.class_id = 0x4321ul << 40, .vptr = 0x1234};
+    bool rejected = map->find(unknown) == NULL;
+
+    bool passed = bounded && all_found && matches_agree && rejected;
+    print_test_result("Test portable 8-slot groups", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// 10. Test Single Group at 95% Load Factor
+void test_single_group_table()
+{
+    typedef hm_table<HM_GROUP_SIZE, HM_TYPE_VERIFY, hm_fixed_capacity<1>> hm_tiny_map_t;
+    static hm_table_storage<hm_tiny_map_t, 1> tiny_cache;
+    static const hm_tuning_t tiny_tuning = {
+        .load_factor_pct = 95,
+        .compact_pct = 10,
+        .evict_min_count = 1,
+        .evict_step = 1,
+        .migrate_min_freq = 0,
+        .miss_threshold = 1,
+    };
+    hm_tiny_map_t *map = &tiny_cache.table;
+    map->tuning = &tiny_tuning;
+
+    // 95% of the group rounds up to all of its slots; one must stay empty so
+    // that misses terminate.
+    bool bounded = true;
+    bool all_found = true;
+    for (int i = 0; i < 4 * HM_GROUP_SIZE; i++)
+    {
+        hm_keyv_t kv = {.class_id = ((0xc000ul + i) << 31), .vptr = 0x6000 + i};
+        map->insert(kv, i);
+        if (map->find(kv) == NULL)
+            all_found = false;
+        if (map->items > map->size() - 1)
+            bounded = false;
+    }
+
+    hm_keyv_t unknown = {.class_id = 0x5678ul << 40, .vptr = 0x4321};
+    bool rejected = map->find(unknown) == NULL;
+
+    bool passed = bounded && all_found && rejected;
+    print_test_result("Test single group at 95% load factor", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// Main Test Runner
+int main()
+{
+    printf("Running VCFI Hashmap Tests...\n\n");
+
+    // Basic functionality tests
+    test_hash_function();
+    test_key_comparison();
+
+    // // VCFI verification tests
+    test_basic_vcall_validation();
+    test_vcall_migration_threshold();
+    test_high_frequency_migration();
+
+    // Cache eviction tests
+    test_verify_cache_eviction();
+    test_record_cache_eviction();
+    test_tombstone_compaction();
+    test_portable_groups();
+    test_single_group_table();
+
+    printf("\nTest Summary: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed == 0 ? 0 : 1;
+}
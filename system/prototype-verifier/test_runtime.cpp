@@ -0,0 +1,158 @@
+#include "xvcfiopt/cfi_xdso_cache.cpp"
+#include "xvcfiopt/xvcfiopt_flags.cpp"
+#include <pthread.h>
+#include <stdio.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Tests of the xvcfiopt runtime itself (compiler-rt/lib/xvcfiopt), built on
+// top of the sanitizer_common stand-ins in runtime_stubs/, like
+// bench_hashmap. The runtime keeps global state, so every test runs in a
+// process of its own.
+//
+// Usage: make runtime_tests && ./runtime_tests
+
+// The one module registered with the runtime.
+#define TEST_MODULE_BEGIN 0x7f1200100000ul
+#define TEST_MODULE_END (TEST_MODULE_BEGIN + 0x1000000)
+static const char test_module_id = 0;
+
+// Helper function to print test results
+void print_test_result(const char *test_name, bool passed)
+{
+    printf("%-50s %s\n", test_name, passed ? "PASSED" : "FAILED");
+}
+
+// Test case counter
+static int tests_passed = 0;
+static int tests_failed = 0;
+
+static void init_runtime()
+{
+    __xvcfiopt::InitAsPlugin();
+    __xvcfiopt::BeginModuleUpdate();
+    __xvcfiopt::AddModule(&test_module_id, "test", TEST_MODULE_BEGIN, TEST_MODULE_END);
+    __xvcfiopt::EndModuleUpdate();
+}
+
+static void call_signature(int i)
+{
+    __cfi_slowpath(100 + i, (void *)(TEST_MODULE_BEGIN + 16 * (i % 0x100000)));
+}
+
+// Run test in a child process; false if it failed or crashed.
+static bool run_in_child(bool (*test)())
+{
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+        _exit(test() ? 0 : 1);
+    int status;
+    return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// 1. Test Adaptive Controller with xvcfi_miss_threshold=1
+static bool adaptive_min_miss_threshold()
+{
+    __xvcfiopt::flags()->SetDefaults();
+    __xvcfiopt::flags()->xvcfi_adaptive = true;
+    __xvcfiopt::flags()->xvcfi_background_migration = true;
+    __xvcfiopt::flags()->xvcfi_miss_threshold = 1;
+    init_runtime();
+
+    // A hot set with a trickle of new signatures raises the average hit
+    // ratio; the maintenance thread gets to run now and then.
+    int fresh = 1000;
+    for (int round = 0; round < 2000; round++)
+    {
+        for (int i = 0; i < 32; i++)
+            call_signature(i);
+        call_signature(fresh++);
+        if (round % 50 == 0)
+            usleep(100);
+    }
+
+    // Only new signatures: a phase change, which lowers the threshold
+    // towards a quarter of 1.
+    int min_threshold = hm_tuning.miss_threshold;
+    for (int i = 0; i < 20000; i++)
+    {
+        call_signature(fresh++);
+        if (hm_tuning.miss_threshold < min_threshold)
+            min_threshold = hm_tuning.miss_threshold;
+    }
+    return min_threshold >= 1;
+}
+
+void test_adaptive_min_miss_threshold()
+{
+    bool passed = run_in_child(adaptive_min_miss_threshold);
+    print_test_result("Test adaptive policy with miss threshold 1", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// 2. Test Fork While Another Thread Holds the Record Lock
+static void *hold_record_lock(void *arg)
+{
+    while (__atomic_test_and_set(&g_record_cache_lock, __ATOMIC_ACQUIRE))
+        internal_sched_yield();
+    *(volatile bool *)arg = true;
+    usleep(50000);
+    __atomic_clear(&g_record_cache_lock, __ATOMIC_RELEASE);
+    return NULL;
+}
+
+static bool fork_with_record_lock_held()
+{
+    __xvcfiopt::flags()->SetDefaults();
+    init_runtime();
+    for (int i = 0; i < 1000; i++)
+        call_signature(i % 32);
+
+    volatile bool held = false;
+    pthread_t thread;
+    pthread_create(&thread, NULL, hold_record_lock, (void *)&held);
+    while (!held)
+        usleep(100);
+
+    // The child updates its modules, e.g. a dlclose, and exits; it is killed
+    // if that hangs on the lock.
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        alarm(5);
+        __xvcfiopt::BeginModuleUpdate();
+        __xvcfiopt::EndModuleUpdate();
+        call_signature(0);
+        _exit(0);
+    }
+    int status;
+    bool child_done = waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+    pthread_join(thread, NULL);
+    return child_done;
+}
+
+void test_fork_with_record_lock_held()
+{
+    bool passed = run_in_child(fork_with_record_lock_held);
+    print_test_result("Test fork while the record lock is held", passed);
+    if (passed)
+        tests_passed++;
+    else
+        tests_failed++;
+}
+
+// Main Test Runner
+int main()
+{
+    printf("Running xvcfiopt Runtime Tests...\n\n");
+
+    test_adaptive_min_miss_threshold();
+    test_fork_with_record_lock_held();
+
+    printf("\nTest Summary: %d passed, %d failed\n", tests_passed, tests_failed);
+    return tests_failed == 0 ? 0 : 1;
+}